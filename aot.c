@@ -0,0 +1,227 @@
+#include "aot.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+static void* library;
+static const struct chip8_aot_module_t* module;
+static struct aot_state_t state;
+// built from the module's block table at load time
+static uint8_t block_lengths[CHIP8_MEMORY_SIZE];
+static uint8_t code_map[CHIP8_MEMORY_SIZE / 8];
+// leader of the block each compiled instruction belongs to
+static uint16_t block_owner[CHIP8_MEMORY_SIZE];
+
+#define NO_BLOCK 0xFFFF
+
+#define BITMAP_TEST(bitmap, addr) ((bitmap)[(addr) >> 3] & (1 << ((addr)&7)))
+#define BITMAP_SET(bitmap, addr) ((bitmap)[(addr) >> 3] |= 1 << ((addr)&7))
+
+static void* library_open(const char* filename) {
+#if defined(_WIN32)
+  return (void*)LoadLibraryA(filename);
+#else
+  // without a slash dlopen() searches the library path instead of the
+  // current directory
+  char path[4096];
+  if(!strchr(filename, '/') &&
+     snprintf(path, sizeof(path), "./%s", filename) < (int)sizeof(path)) {
+    filename = path;
+  }
+  return dlopen(filename, RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+static const char* library_error() {
+#if defined(_WIN32)
+  static char message[32];
+  snprintf(message, sizeof(message), "error %lu",
+           (unsigned long)GetLastError());
+  return message;
+#else
+  const char* message = dlerror();
+  return message ? message : "unknown error";
+#endif
+}
+
+static void* library_symbol(void* handle, const char* name) {
+#if defined(_WIN32)
+  return (void*)GetProcAddress((HMODULE)handle, name);
+#else
+  return dlsym(handle, name);
+#endif
+}
+
+static void library_close(void* handle) {
+#if defined(_WIN32)
+  FreeLibrary((HMODULE)handle);
+#else
+  dlclose(handle);
+#endif
+}
+
+int aot_load(const char* filename, const struct chip8_t* chip8) {
+  static const size_t LAYOUT[CHIP8_AOT_LAYOUT_SIZE] = CHIP8_AOT_LAYOUT;
+  library = library_open(filename);
+  if(!library) {
+    fprintf(stderr, "can't load compiled rom: '%s' (%s)\n", filename,
+            library_error());
+    return 0;
+  }
+  module = (const struct chip8_aot_module_t*)library_symbol(library,
+                                                           CHIP8_AOT_SYMBOL);
+  if(!module || module->abi_version != CHIP8_AOT_ABI_VERSION) {
+    fprintf(stderr, "'%s' is not a compiled rom for this emulator\n",
+            filename);
+    aot_unload();
+    return 0;
+  }
+  if(memcmp(module->layout, LAYOUT, sizeof(LAYOUT)) != 0) {
+    fprintf(stderr,
+            "'%s' was compiled against a different struct chip8_t, "
+            "recompile it\n",
+            filename);
+    aot_unload();
+    return 0;
+  }
+  if(module->rom_size > CHIP8_MEMORY_SIZE - CHIP8_MEMORY_START ||
+     memcmp(module->rom, chip8->memory + CHIP8_MEMORY_START,
+            module->rom_size) != 0) {
+    fprintf(stderr, "'%s' was compiled from a different rom\n", filename);
+    aot_unload();
+    return 0;
+  }
+  memset(block_owner, 0xFF, sizeof(block_owner));
+  for(uint16_t i = 0; i < module->block_count; i++) {
+    const struct chip8_aot_block_t* block = &module->blocks[i];
+    if(block->leader + 2 * block->length > CHIP8_MEMORY_SIZE ||
+       block->length > UINT8_MAX) {
+      fprintf(stderr, "'%s' has an invalid block at 0x%.4X\n", filename,
+              block->leader);
+      aot_unload();
+      return 0;
+    }
+    block_lengths[block->leader] = (uint8_t)block->length;
+    for(int addr = block->leader; addr < block->leader + 2 * block->length;
+        addr++) {
+      BITMAP_SET(code_map, addr);
+    }
+    for(int n = 0; n < block->length; n++) {
+      block_owner[block->leader + 2 * n] = block->leader;
+    }
+  }
+  return 1;
+}
+
+/**
+ * Marks every block that the FX33/FX55 just executed wrote into as
+ * invalid, so it is interpreted from now on; the rest of the module keeps
+ * running compiled.
+ */
+static void aot_invalidate(const struct chip8_t* chip8) {
+  int len;
+  if((chip8->opcode & 0xF0FF) == 0xF033) {
+    len = 3;
+  } else if((chip8->opcode & 0xF0FF) == 0xF055) {
+    len = ((chip8->opcode >> 8) & 0xF) + 1;
+  } else {
+    return;
+  }
+  int from = chip8->I, to = chip8->I + len;
+  int written = 0;
+  for(int addr = from; addr < to && addr < CHIP8_MEMORY_SIZE; addr++) {
+    if(BITMAP_TEST(code_map, addr)) {
+      written = 1;
+      break;
+    }
+  }
+  if(!written) {
+    return;
+  }
+  for(uint16_t i = 0; i < module->block_count; i++) {
+    const struct chip8_aot_block_t* block = &module->blocks[i];
+    if(block->leader < to && from < block->leader + 2 * block->length &&
+       !BITMAP_TEST(state.invalid, block->leader)) {
+      BITMAP_SET(state.invalid, block->leader);
+      state.count++;
+    }
+  }
+}
+
+static int compiled(uint16_t pc) {
+  return pc < CHIP8_MEMORY_SIZE && block_owner[pc] != NO_BLOCK &&
+         !BITMAP_TEST(state.invalid, block_owner[pc]);
+}
+
+/**
+ * Runs until chip8->cycles reaches 'cycles'. The module never runs past the
+ * budget, so the machine stops on the exact cycle the interpreter would;
+ * whatever the module cannot run is interpreted one instruction at a time.
+ */
+void aot_run(struct chip8_t* chip8, uint64_t cycles) {
+  if(!module) {
+    while(chip8->cycles < cycles) {
+      chip8_cricle(chip8);
+    }
+    return;
+  }
+  while(chip8->cycles < cycles) {
+    if(compiled(chip8->pc)) {
+      if(module->run(chip8, cycles, state.count ? state.invalid : NULL)) {
+        aot_invalidate(chip8);
+        continue;
+      }
+      if(chip8->cycles >= cycles) {
+        break;
+      }
+    }
+    chip8_cricle(chip8);
+    // FX33 and FX55 are the only instructions that write memory
+    if((chip8->opcode & 0xF000) == 0xF000) {
+      aot_invalidate(chip8);
+    }
+  }
+}
+
+/**
+ * Runs one compiled block if pc is at a valid leader and the block fits
+ * before 'cycles', otherwise a single instruction, compiled or
+ * interpreted. Returns the length of the block, or 0 for a single
+ * instruction.
+ */
+int aot_step(struct chip8_t* chip8, uint64_t cycles) {
+  uint64_t start = chip8->cycles;
+  int length = 0;
+  if(module && compiled(chip8->pc) &&
+     start + block_lengths[chip8->pc] <= cycles) {
+    length = block_lengths[chip8->pc];
+  }
+  aot_run(chip8, start + (length ? length : 1));
+  return length;
+}
+
+void aot_save(struct aot_state_t* saved) {
+  *saved = state;
+}
+
+void aot_restore(const struct aot_state_t* saved) {
+  state = *saved;
+}
+
+void aot_unload() {
+  if(library) {
+    library_close(library);
+  }
+  library = NULL;
+  module = NULL;
+  memset(&state, 0, sizeof(state));
+  memset(block_lengths, 0, sizeof(block_lengths));
+  memset(code_map, 0, sizeof(code_map));
+  memset(block_owner, 0xFF, sizeof(block_owner));
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "chip8.h"
+
+/**
+ * Ahead-of-time compiled ROMs. chip8-recompile turns a ROM into a C file
+ * with one function per basic block and a switch over the block leaders
+ * that chains them; built as a shared object it exports a
+ * struct chip8_aot_module_t named CHIP8_AOT_SYMBOL that aot_load() picks up.
+ */
+#define CHIP8_AOT_ABI_VERSION 2
+#define CHIP8_AOT_SYMBOL "chip8_aot_module"
+
+/**
+ * The struct chip8_t layout a module was compiled against. Modules access
+ * the machine through compiled-in offsets, so aot_load() rejects any
+ * module whose layout differs from the emulator's.
+ */
+#define CHIP8_AOT_LAYOUT                                                     \
+  {                                                                          \
+    sizeof(struct chip8_t), offsetof(struct chip8_t, V),                     \
+      offsetof(struct chip8_t, I), offsetof(struct chip8_t, pc),             \
+      offsetof(struct chip8_t, opcode), offsetof(struct chip8_t, cycles),    \
+      offsetof(struct chip8_t, delay_deadline),                              \
+      offsetof(struct chip8_t, sound_deadline),                              \
+      offsetof(struct chip8_t, memory), offsetof(struct chip8_t, stack),     \
+      offsetof(struct chip8_t, sp), offsetof(struct chip8_t, keystate),      \
+      offsetof(struct chip8_t, gfx), offsetof(struct chip8_t, draw_flag),    \
+      offsetof(struct chip8_t, rng)                                          \
+  }
+#define CHIP8_AOT_LAYOUT_SIZE 15
+
+#if defined(_WIN32)
+#define CHIP8_AOT_EXPORT __declspec(dllexport)
+#else
+#define CHIP8_AOT_EXPORT
+#endif
+
+/**
+ * Runs compiled code until 'cycles', leaving it when pc reaches an address
+ * that is not compiled or belongs to a block marked in 'invalid' (one bit
+ * per leader address, NULL while no block is). Whole blocks run only when
+ * they fit the budget; otherwise compiled instructions run one at a time.
+ * Returns non-zero right after compiled code wrote over compiled code;
+ * chip8->opcode is then the FX33/FX55 that did it.
+ */
+typedef int (*chip8_aot_run_t)(struct chip8_t* chip8, uint64_t cycles,
+                               const uint8_t* invalid);
+
+struct chip8_aot_block_t {
+  uint16_t leader;
+  uint16_t length;  // in instructions
+};
+
+struct chip8_aot_module_t {
+  int abi_version;
+  size_t layout[CHIP8_AOT_LAYOUT_SIZE];
+  uint16_t rom_size;
+  const uint8_t* rom;
+  uint16_t block_count;
+  const struct chip8_aot_block_t* blocks;
+  chip8_aot_run_t run;
+};
+
+/**
+ * Run-time state of the loaded module: the blocks that were overwritten
+ * and are interpreted from then on. Tools that snapshot and replay a
+ * machine save and restore it along with the struct chip8_t.
+ */
+struct aot_state_t {
+  int count;
+  uint8_t invalid[CHIP8_MEMORY_SIZE / 8];
+};
+
+int aot_load(const char* filename, const struct chip8_t* chip8);
+
+void aot_run(struct chip8_t* chip8, uint64_t cycles);
+
+int aot_step(struct chip8_t* chip8, uint64_t cycles);
+
+void aot_save(struct aot_state_t* state);
+
+void aot_restore(const struct aot_state_t* state);
+
+void aot_unload();
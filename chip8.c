@@ -1,7 +1,7 @@
 #include "chip8.h"
+#include "chip8_ops.h"
 
 #include <malloc.h>
-#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -24,275 +24,13 @@ static uint8_t CHIP8_FONTSET[CHIP8_FONTSET_SIZE] = {
   0xF0, 0x80, 0xF0, 0x80, 0x80  /* F */
 };
 
-#if defined(NDEBUG)
-static inline void debug_printf(const char* fmt, ...) {}
-#else
-static inline void debug_printf(const char* fmt, ...) {
-  va_list ap;
-  va_start(ap, fmt);
-  vprintf(fmt, ap);
-  va_end(ap);
-  printf("\n\n");
-}
-#endif
-
-static inline void opcode_raw(struct chip8_t* chip8) {
-  debug_printf("raw 0x%.4X", chip8->opcode);
-  chip8->pc += 2;
-}
-
-static inline void opcode_00E0(struct chip8_t* chip8) {
-  debug_printf("cls");
-  memset(chip8->gfx, 0, sizeof(chip8->gfx));
-  chip8->draw_flag = 1;
-  chip8->pc += 2;
-}
-
-static inline void opcode_00EE(struct chip8_t* chip8) {
-  debug_printf("ret");
-  chip8->pc = chip8->stack[--chip8->sp];
-}
-
-static inline void opcode_1NNN(struct chip8_t* chip8) {
-  debug_printf("jp 0x%X", chip8->D.NNN);
-  chip8->pc = chip8->D.NNN;
-}
-
-static inline void opcode_2NNN(struct chip8_t* chip8) {
-  debug_printf("call 0x%X", chip8->D.NNN);
-  chip8->stack[chip8->sp++] = chip8->pc + 2;
-  chip8->pc = chip8->D.NNN;
-}
-
-static inline void opcode_3XNN(struct chip8_t* chip8) {
-  debug_printf("se v%d, 0x%X", chip8->D.X, chip8->D.NN);
-  chip8->pc += (chip8->V[chip8->D.X] == chip8->D.NN) ? 4 : 2;
-}
-
-static inline void opcode_4XNN(struct chip8_t* chip8) {
-  debug_printf("sne v%d, 0x%X", chip8->D.X, chip8->D.NN);
-  chip8->pc += (chip8->V[chip8->D.X] != chip8->D.NN) ? 4 : 2;
-}
-
-static inline void opcode_5XY0(struct chip8_t* chip8) {
-  debug_printf("se v%d, v%d", chip8->D.X, chip8->D.Y);
-  chip8->pc += (chip8->V[chip8->D.X] == chip8->V[chip8->D.Y]) ? 4 : 2;
-}
-
-static inline void opcode_6XNN(struct chip8_t* chip8) {
-  debug_printf("ld v%d, 0x%X", chip8->D.X, chip8->D.NN);
-  chip8->V[chip8->D.X] = chip8->D.NN;
-  chip8->pc += 2;
-}
-
-static inline void opcode_7XNN(struct chip8_t* chip8) {
-  debug_printf("add v%d, 0x%X", chip8->D.X, chip8->D.NN);
-  chip8->V[chip8->D.X] += chip8->D.NN;
-  chip8->pc += 2;
-}
-
-static inline void opcode_8XY0(struct chip8_t* chip8) {
-  debug_printf("ld v%d, v%d", chip8->D.X, chip8->D.Y);
-  chip8->V[chip8->D.X] = chip8->V[chip8->D.Y];
-  chip8->pc += 2;
-}
-
-static inline void opcode_8XY1(struct chip8_t* chip8) {
-  debug_printf("or v%d, v%d", chip8->D.X, chip8->D.Y);
-  chip8->V[chip8->D.X] |= chip8->V[chip8->D.Y];
-  chip8->pc += 2;
-}
-
-static inline void opcode_8XY2(struct chip8_t* chip8) {
-  debug_printf("and v%d, v%d", chip8->D.X, chip8->D.Y);
-  chip8->V[chip8->D.X] &= chip8->V[chip8->D.Y];
-  chip8->pc += 2;
-}
-
-static inline void opcode_8XY3(struct chip8_t* chip8) {
-  debug_printf("xor v%d, v%d", chip8->D.X, chip8->D.Y);
-  chip8->V[chip8->D.X] ^= chip8->V[chip8->D.Y];
-  chip8->pc += 2;
-}
-
-static inline void opcode_8XY4(struct chip8_t* chip8) {
-  debug_printf("add v%d, v%d", chip8->D.X, chip8->D.Y);
-  uint16_t added = (uint16_t)(((uint16_t)chip8->V[chip8->D.X]) +
-                              ((uint16_t)chip8->V[chip8->D.Y]));
-  chip8->V[chip8->D.X] = added & 0xFF;
-  chip8->V[0xF] = (added & 0x0100) >> 8;
-  chip8->pc += 2;
-}
-
-static inline void opcode_8XY5(struct chip8_t* chip8) {
-  debug_printf("sub v%d, v%d", chip8->D.X, chip8->D.Y);
-  if(chip8->V[chip8->D.X] > chip8->V[chip8->D.Y]) {
-    chip8->V[0xF] = 1;
-  } else {
-    chip8->V[0xF] = 0;
-  }
-  chip8->V[chip8->D.X] -= chip8->V[chip8->D.Y];
-  chip8->pc += 2;
-}
-
-static inline void opcode_8XY6(struct chip8_t* chip8) {
-  debug_printf("shr v%d", chip8->D.X);
-  chip8->V[0xF] = chip8->V[chip8->D.X] & 0x01;
-  chip8->V[chip8->D.X] >>= 1;
-  chip8->pc += 2;
-}
-
-static inline void opcode_8XY7(struct chip8_t* chip8) {
-  debug_printf("subn v%d, v%d", chip8->D.X, chip8->D.Y);
-  if(chip8->V[chip8->D.X] < chip8->V[chip8->D.Y]) {
-    chip8->V[0xF] = 1;
-  } else {
-    chip8->V[0xF] = 0;
-  }
-  chip8->V[chip8->D.X] = chip8->V[chip8->D.Y] - chip8->V[chip8->D.X];
-  chip8->pc += 2;
-}
-
-static inline void opcode_8XYE(struct chip8_t* chip8) {
-  debug_printf("shl v%d", chip8->D.X);
-  chip8->V[0xF] = (chip8->V[chip8->D.X] * 0x80) >> 7;
-  chip8->V[chip8->D.X] <<= 1;
-  chip8->pc += 2;
-}
-
-static inline void opcode_9XY0(struct chip8_t* chip8) {
-  debug_printf("sne v%d, v%d", chip8->D.X, chip8->D.Y);
-  chip8->pc += chip8->V[chip8->D.X] != chip8->V[chip8->D.Y] ? 4 : 2;
-}
-
-static inline void opcode_ANNN(struct chip8_t* chip8) {
-  debug_printf("ld I, 0x%x", chip8->D.NNN);
-  chip8->I = chip8->D.NNN;
-  chip8->pc += 2;
-}
-
-static inline void opcode_BNNN(struct chip8_t* chip8) {
-  debug_printf("jp v0, 0x%x", chip8->D.NNN);
-  chip8->pc = chip8->V[0x0] + chip8->D.NNN;
-}
-
-static inline void opcode_CXNN(struct chip8_t* chip8) {
-  debug_printf("rnd v%d, 0x%x", chip8->D.X, chip8->D.NN);
-  chip8->V[chip8->D.X] = (rand() % 256) & chip8->D.NN;
-  chip8->pc += 2;
-}
-
-static inline void opcode_DXYN(struct chip8_t* chip8) {
-  debug_printf("drw v%d, v%d, 0x%x", chip8->D.X, chip8->D.Y, chip8->D.N);
-  chip8->V[0xF] = 0;
-  uint8_t sx = chip8->V[chip8->D.X];
-  uint8_t sy = chip8->V[chip8->D.Y];
-  uint8_t height = chip8->D.N;
-  for(uint8_t i = 0; i < height; i++) {
-    for(uint8_t j = 0; j < 8; j++) {
-      uint8_t pixel = (chip8->memory[chip8->I + (uint16_t)i] & (0x80 >> j));
-      uint8_t cx = sx + j;
-      uint8_t cy = sy + i;
-      if(cx >= CHIP8_DISPLAY_WIDTH || cy >= CHIP8_DISPLAY_HEIGHT) {
-        continue;
-      }
-      if(pixel) {
-        if(chip8->gfx[cy][cx] == CHIP8_DISPLAY_WHITE) {
-          chip8->V[0xF] = 1;
-        }
-        chip8->gfx[cy][cx] = chip8->gfx[cy][cx] == CHIP8_DISPLAY_WHITE
-                               ? CHIP8_DISPLAY_BLACK
-                               : CHIP8_DISPLAY_WHITE;
-      }
-    }
-  }
-  chip8->draw_flag = 1;
-  chip8->pc += 2;
-}
-static inline void opcode_EX9E(struct chip8_t* chip8) {
-  debug_printf("skp v%d", chip8->D.X);
-  chip8->pc += chip8->keystate[chip8->V[chip8->D.X]] ? 4 : 2;
-}
-
-static inline void opcode_EXA1(struct chip8_t* chip8) {
-  debug_printf("sknp v%d", chip8->D.X);
-  chip8->pc += !chip8->keystate[chip8->V[chip8->D.X]] ? 4 : 2;
-}
-
-static inline void opcode_FX07(struct chip8_t* chip8) {
-  debug_printf("ld v%d, DT", chip8->D.X);
-  chip8->V[chip8->D.X] = chip8->delay_timer;
-  chip8->pc += 2;
-}
-
-static inline void opcode_FX0A(struct chip8_t* chip8) {
-  debug_printf("ld v%d, K", chip8->D.X);
-  int keypressed = 0;
-  for(uint8_t i = 0; i < CHIP8_KEY_SIZE; i++) {
-    if(chip8->keystate[i]) {
-      chip8->V[chip8->D.X] = i;
-      keypressed = 1;
-    }
-  }
-  if(keypressed) {
-    chip8->pc += 2;
-  }
-}
-
-static inline void opcode_FX15(struct chip8_t* chip8) {
-  debug_printf("ld DT, v%d", chip8->D.X);
-  chip8->delay_timer = chip8->V[chip8->D.X];
-  chip8->pc += 2;
-}
-
-static inline void opcode_FX18(struct chip8_t* chip8) {
-  debug_printf("ld ST, v%d", chip8->D.X);
-  chip8->sound_timer = chip8->V[chip8->D.X];
-  chip8->pc += 2;
-}
-
-static inline void opcode_FX1E(struct chip8_t* chip8) {
-  debug_printf("add I, v%d", chip8->D.X);
-  chip8->I += chip8->V[chip8->D.X];
-  chip8->pc += 2;
-}
-
-static inline void opcode_FX29(struct chip8_t* chip8) {
-  debug_printf("ld F, v%d", chip8->D.X);
-  chip8->I = CHIP8_FONTSET_MEM_START + chip8->V[chip8->D.X] * 5;
-  chip8->pc += 2;
-}
-
-static inline void opcode_FX33(struct chip8_t* chip8) {
-  debug_printf("ld B, v%d", chip8->D.X);
-  uint8_t x = chip8->V[chip8->D.X];
-  chip8->memory[chip8->I] = (x % 1000) / 100;
-  chip8->memory[chip8->I + 1] = (x % 100) / 10;
-  chip8->memory[chip8->I + 2] = (x % 10);
-  chip8->pc += 2;
-}
-
-static inline void opcode_FX55(struct chip8_t* chip8) {
-  debug_printf("ld [I], v%d", chip8->D.X);
-  for(uint8_t i = 0; i <= chip8->D.X; i++) {
-    chip8->memory[chip8->I + i] = chip8->V[i];
-  }
-  chip8->pc += 2;
-}
-
-static inline void opcode_FX65(struct chip8_t* chip8) {
-  debug_printf("ld v%d, [I]", chip8->D.X);
-  for(uint8_t i = 0; i <= chip8->D.X; i++) {
-    chip8->V[i] = chip8->memory[chip8->I + i];
-  }
-  chip8->pc += 2;
-}
-
 void chip8_init(struct chip8_t* chip8) {
   memset(chip8, 0, sizeof(struct chip8_t));
   for(int i = 0; i < CHIP8_FONTSET_SIZE; i++) {
     chip8->memory[CHIP8_FONTSET_MEM_START + i] = CHIP8_FONTSET[i];
   }
+  chip8->rng = CHIP8_RANDOM_SEED;
+
   chip8->state = CHIP8_STATE_READY;
 }
 
@@ -318,17 +56,8 @@ int chip8_load_program(struct chip8_t* chip8, const char* filename) {
 }
 
 void chip8_cricle(struct chip8_t* chip8) {
-  // fetch
-  chip8->opcode = ((chip8->memory[chip8->pc] << 8) & 0xff00) |
-                  (chip8->memory[chip8->pc + 1] & 0xff);
-
-  // decode
-  chip8->D.I = ((chip8->opcode & 0xF000u) >> 12);
-  chip8->D.X = ((chip8->opcode & 0x0F00u) >> 8);
-  chip8->D.Y = ((chip8->opcode & 0x00F0u) >> 4);
-  chip8->D.N = (chip8->opcode & 0x000Fu);
-  chip8->D.NN = (chip8->opcode & 0x00FFu);
-  chip8->D.NNN = (chip8->opcode & 0x0FFFu);
+  chip8_fetch_decode(chip8);
+  chip8->cycles++;
 
   // execute
   switch(chip8->D.I) {
@@ -454,25 +183,229 @@ void chip8_cricle(struct chip8_t* chip8) {
   opcode_raw(chip8);
 }
 
-void chip8_dump_pc(struct chip8_t* chip8) {
-  printf("\n\nDump Program Counter:\nPC: 0x%.4X\nOpcode: 0x%.4X\n", chip8->pc,
-         chip8->opcode);
+/**
+ * Alternative engine: the same opcode handlers reached through lookup
+ * tables instead of the nested switch. It must stay bit-exact with
+ * chip8_cricle, which is what tools/lockstep checks.
+ */
+typedef void (*opcode_handler_t)(struct chip8_t* chip8);
+
+static const opcode_handler_t OPCODE_0_TABLE[256] = {
+  [0xE0] = opcode_00E0,
+  [0xEE] = opcode_00EE
+};
+
+static const opcode_handler_t OPCODE_8_TABLE[16] = {
+  [0x0] = opcode_8XY0, [0x1] = opcode_8XY1, [0x2] = opcode_8XY2,
+  [0x3] = opcode_8XY3, [0x4] = opcode_8XY4, [0x5] = opcode_8XY5,
+  [0x6] = opcode_8XY6, [0x7] = opcode_8XY7, [0xE] = opcode_8XYE
+};
+
+static const opcode_handler_t OPCODE_E_TABLE[256] = {
+  [0x9E] = opcode_EX9E,
+  [0xA1] = opcode_EXA1
+};
+
+static const opcode_handler_t OPCODE_F_TABLE[256] = {
+  [0x07] = opcode_FX07, [0x0A] = opcode_FX0A, [0x15] = opcode_FX15,
+  [0x18] = opcode_FX18, [0x1E] = opcode_FX1E, [0x29] = opcode_FX29,
+  [0x33] = opcode_FX33, [0x55] = opcode_FX55, [0x65] = opcode_FX65
+};
+
+static inline void opcode_dispatch(struct chip8_t* chip8,
+                                   opcode_handler_t handler) {
+  (handler ? handler : opcode_raw)(chip8);
+}
+
+static void opcode_group_0(struct chip8_t* chip8) {
+  opcode_dispatch(chip8, OPCODE_0_TABLE[chip8->D.NN]);
+}
+
+static void opcode_group_8(struct chip8_t* chip8) {
+  opcode_dispatch(chip8, OPCODE_8_TABLE[chip8->D.N]);
+}
+
+static void opcode_group_E(struct chip8_t* chip8) {
+  opcode_dispatch(chip8, OPCODE_E_TABLE[chip8->D.NN]);
+}
+
+static void opcode_group_F(struct chip8_t* chip8) {
+  opcode_dispatch(chip8, OPCODE_F_TABLE[chip8->D.NN]);
+}
+
+static const opcode_handler_t OPCODE_TABLE[16] = {
+  opcode_group_0, opcode_1NNN, opcode_2NNN,    opcode_3XNN,
+  opcode_4XNN,    opcode_5XY0, opcode_6XNN,    opcode_7XNN,
+  opcode_group_8, opcode_9XY0, opcode_ANNN,    opcode_BNNN,
+  opcode_CXNN,    opcode_DXYN, opcode_group_E, opcode_group_F
+};
+
+void chip8_cricle_table(struct chip8_t* chip8) {
+  chip8_fetch_decode(chip8);
+  chip8->cycles++;
+  OPCODE_TABLE[chip8->D.I](chip8);
+}
+
+uint8_t chip8_delay_timer(const struct chip8_t* chip8) {
+  return timer_value(chip8, chip8->delay_deadline);
+}
+
+uint8_t chip8_sound_timer(const struct chip8_t* chip8) {
+  return timer_value(chip8, chip8->sound_deadline);
+}
+
+static inline uint64_t hash_mix(uint64_t h, uint64_t word) {
+  return ((h << 5 | h >> 59) ^ word) * 0x517CC1B727220A95ull;
+}
+
+static uint64_t hash_bytes(uint64_t h, const void* data, size_t size) {
+  const uint8_t* p = (const uint8_t*)data;
+  uint64_t word;
+  for(; size >= sizeof(word); size -= sizeof(word), p += sizeof(word)) {
+    memcpy(&word, p, sizeof(word));
+    h = hash_mix(h, word);
+  }
+  word = 0;
+  memcpy(&word, p, size);
+  return hash_mix(h, word ^ size);
+}
+
+/**
+ * Hash of everything that defines the machine's observable state. The
+ * decode scratch (opcode, D) and the host-side state/draw_flag are left
+ * out so engines that do not fill them in still compare equal.
+ */
+uint64_t chip8_hash(const struct chip8_t* chip8) {
+  uint64_t h = hash_bytes(0, chip8->V, sizeof(chip8->V));
+  uint64_t now = timer_now(chip8);
+  h = hash_mix(h, (uint64_t)chip8->I << 32 | (uint64_t)chip8->pc << 16 |
+                    chip8->sp);
+  h = hash_mix(h, chip8->cycles);
+  // expired deadlines all read as zero, so hash the time left instead
+  h = hash_mix(h, chip8->delay_deadline > now ? chip8->delay_deadline - now
+                                              : 0);
+  h = hash_mix(h, chip8->sound_deadline > now ? chip8->sound_deadline - now
+                                              : 0);
+  h = hash_mix(h, chip8->rng);
+  h = hash_bytes(h, chip8->stack, sizeof(chip8->stack));
+  h = hash_bytes(h, chip8->keystate, sizeof(chip8->keystate));
+  h = hash_bytes(h, chip8->memory, sizeof(chip8->memory));
+  return hash_bytes(h, chip8->gfx, sizeof(chip8->gfx));
+}
+
+uint64_t chip8_hash_display(const struct chip8_t* chip8) {
+  return hash_bytes(0, chip8->gfx, sizeof(chip8->gfx));
+}
+
+/**
+ * Formats one instruction with the same mnemonics the debug trace uses.
+ * Returns the snprintf() result.
+ */
+int chip8_disassemble(uint16_t opcode, char* buf, size_t size) {
+  uint8_t X = (opcode & 0x0F00u) >> 8;
+  uint8_t Y = (opcode & 0x00F0u) >> 4;
+  uint8_t N = opcode & 0x000Fu;
+  uint8_t NN = opcode & 0x00FFu;
+  uint16_t NNN = opcode & 0x0FFFu;
+  switch(opcode >> 12) {
+    case 0x0:
+      if(opcode == 0x00E0) {
+        return snprintf(buf, size, "cls");
+      } else if(opcode == 0x00EE) {
+        return snprintf(buf, size, "ret");
+      }
+      break;
+    case 0x1:
+      return snprintf(buf, size, "jp 0x%X", NNN);
+    case 0x2:
+      return snprintf(buf, size, "call 0x%X", NNN);
+    case 0x3:
+      return snprintf(buf, size, "se v%d, 0x%X", X, NN);
+    case 0x4:
+      return snprintf(buf, size, "sne v%d, 0x%X", X, NN);
+    case 0x5:
+      return snprintf(buf, size, "se v%d, v%d", X, Y);
+    case 0x6:
+      return snprintf(buf, size, "ld v%d, 0x%X", X, NN);
+    case 0x7:
+      return snprintf(buf, size, "add v%d, 0x%X", X, NN);
+    case 0x8: {
+      static const char* const ALU[16] = {
+        "ld", "or", "and", "xor", "add", "sub", "shr", "subn",
+        NULL, NULL, NULL, NULL, NULL, NULL, "shl", NULL
+      };
+      if(N == 0x6 || N == 0xE) {
+        return snprintf(buf, size, "%s v%d", ALU[N], X);
+      } else if(ALU[N]) {
+        return snprintf(buf, size, "%s v%d, v%d", ALU[N], X, Y);
+      }
+      break;
+    }
+    case 0x9:
+      return snprintf(buf, size, "sne v%d, v%d", X, Y);
+    case 0xA:
+      return snprintf(buf, size, "ld I, 0x%x", NNN);
+    case 0xB:
+      return snprintf(buf, size, "jp v0, 0x%x", NNN);
+    case 0xC:
+      return snprintf(buf, size, "rnd v%d, 0x%x", X, NN);
+    case 0xD:
+      return snprintf(buf, size, "drw v%d, v%d, 0x%x", X, Y, N);
+    case 0xE:
+      if(NN == 0x9E) {
+        return snprintf(buf, size, "skp v%d", X);
+      } else if(NN == 0xA1) {
+        return snprintf(buf, size, "sknp v%d", X);
+      }
+      break;
+    case 0xF:
+      switch(NN) {
+        case 0x07:
+          return snprintf(buf, size, "ld v%d, DT", X);
+        case 0x0A:
+          return snprintf(buf, size, "ld v%d, K", X);
+        case 0x15:
+          return snprintf(buf, size, "ld DT, v%d", X);
+        case 0x18:
+          return snprintf(buf, size, "ld ST, v%d", X);
+        case 0x1E:
+          return snprintf(buf, size, "add I, v%d", X);
+        case 0x29:
+          return snprintf(buf, size, "ld F, v%d", X);
+        case 0x33:
+          return snprintf(buf, size, "ld B, v%d", X);
+        case 0x55:
+          return snprintf(buf, size, "ld [I], v%d", X);
+        case 0x65:
+          return snprintf(buf, size, "ld v%d, [I]", X);
+      }
+      break;
+  }
+  return snprintf(buf, size, "raw 0x%.4X", opcode);
+}
+
+void chip8_dump_pc(struct chip8_t* chip8, FILE* fp) {
+  fprintf(fp, "\n\nDump Program Counter:\nPC: 0x%.4X\nOpcode: 0x%.4X\n",
+          chip8->pc, chip8->opcode);
 }
 
-void chip8_dump_register(struct chip8_t* chip8) {
-  printf("\n\nDump Registers:\n");
+void chip8_dump_register(struct chip8_t* chip8, FILE* fp) {
+  fprintf(fp, "\n\nDump Registers:\n");
   for(int i = 0; i < CHIP8_REGISTER_SIZE; i += 4) {
-    printf("V%X=0x%X\tV%X=0x%X\tV%X=0x%X\tV%X=0x%X\n", i, chip8->V[i], i + 1,
-           chip8->V[i + 1], i + 2, chip8->V[i + 2], i + 3, chip8->V[i + 3]);
+    fprintf(fp, "V%X=0x%X\tV%X=0x%X\tV%X=0x%X\tV%X=0x%X\n", i, chip8->V[i],
+            i + 1, chip8->V[i + 1], i + 2, chip8->V[i + 2], i + 3,
+            chip8->V[i + 3]);
   }
+  fprintf(fp, "I=0x%X\tSP=0x%X\tDT=0x%X\tST=0x%X\n", chip8->I, chip8->sp,
+          chip8_delay_timer(chip8), chip8_sound_timer(chip8));
 }
 
-void chip8_dump_memory(struct chip8_t* chip8) {
-  printf("\n\nDump Memory(hex):\n");
+void chip8_dump_memory(struct chip8_t* chip8, FILE* fp) {
+  fprintf(fp, "\n\nDump Memory(hex):\n");
   for(int i = 0; i < CHIP8_MEMORY_SIZE; i += 8) {
-    printf("%.4X:  %.2X %.2X %.2X %.2X %.2X %.2X %.2X %.2X\n", i,
-           chip8->memory[i], chip8->memory[i + 1], chip8->memory[i + 2],
-           chip8->memory[i + 3], chip8->memory[i + 4], chip8->memory[i + 5],
-           chip8->memory[i + 6], chip8->memory[i + 7]);
+    fprintf(fp, "%.4X:  %.2X %.2X %.2X %.2X %.2X %.2X %.2X %.2X\n", i,
+            chip8->memory[i], chip8->memory[i + 1], chip8->memory[i + 2],
+            chip8->memory[i + 3], chip8->memory[i + 4], chip8->memory[i + 5],
+            chip8->memory[i + 6], chip8->memory[i + 7]);
   }
 }
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #define CHIP8_DISPLAY_HEIGHT 32
 #define CHIP8_DISPLAY_WIDTH 64
@@ -19,6 +21,11 @@
 
 #define CYCLE_DELAY (1000 / 1000)
 #define TIMER_DELAY (1000 / 60)
+#define CHIP8_CYCLES_PER_FRAME (TIMER_DELAY / CYCLE_DELAY)
+#define CHIP8_CYCLE_HZ (1000 / CYCLE_DELAY)
+#define CHIP8_TIMER_HZ 60
+
+#define CHIP8_RANDOM_SEED 0x2545F491u
 
 #define CHIP8_STATE_READY 0
 #define CHIP8_STATE_QUIT 1
@@ -40,23 +47,41 @@ struct chip8_t {
     uint16_t NNN;
     uint8_t KK;
   } D;
-  uint8_t delay_timer, sound_timer;
+  // timers are deadlines on the instruction clock, in units of
+  // 1 / (CHIP8_CYCLE_HZ * CHIP8_TIMER_HZ) seconds; see chip8_delay_timer()
+  uint64_t cycles;
+  uint64_t delay_deadline, sound_deadline;
   uint8_t memory[CHIP8_MEMORY_SIZE];
   uint16_t stack[CHIP8_STACK_SIZE];
   uint8_t sp;
   uint16_t keystate[CHIP8_KEY_SIZE];
   uint32_t gfx[CHIP8_DISPLAY_HEIGHT][CHIP8_DISPLAY_WIDTH];
   uint8_t draw_flag;
+  uint32_t rng;
 };
 
+typedef void (*chip8_engine_t)(struct chip8_t* chip8);
+
 void chip8_init(struct chip8_t* chip8);
 
 int chip8_load_program(struct chip8_t* chip8, const char* filename);
 
 void chip8_cricle(struct chip8_t* chip8);
 
-void chip8_dump_pc(struct chip8_t* chip8);
+void chip8_cricle_table(struct chip8_t* chip8);
+
+uint8_t chip8_delay_timer(const struct chip8_t* chip8);
+
+uint8_t chip8_sound_timer(const struct chip8_t* chip8);
+
+uint64_t chip8_hash(const struct chip8_t* chip8);
+
+uint64_t chip8_hash_display(const struct chip8_t* chip8);
+
+int chip8_disassemble(uint16_t opcode, char* buf, size_t size);
+
+void chip8_dump_pc(struct chip8_t* chip8, FILE* fp);
 
-void chip8_dump_register(struct chip8_t* chip8);
+void chip8_dump_register(struct chip8_t* chip8, FILE* fp);
 
-void chip8_dump_memory(struct chip8_t* chip8);
\ No newline at end of file
+void chip8_dump_memory(struct chip8_t* chip8, FILE* fp);
\ No newline at end of file
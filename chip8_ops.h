@@ -0,0 +1,470 @@
+#pragma once
+
+/**
+ * Opcode semantics shared by every execution engine: the interpreters in
+ * chip8.c and the C translation units emitted by chip8-recompile both call
+ * these handlers, so there is only one definition of what an instruction
+ * does.
+ */
+#include "chip8.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(NDEBUG)
+static inline void debug_printf(const char* fmt, ...) {}
+#else
+static inline void debug_printf(const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vprintf(fmt, ap);
+  va_end(ap);
+  printf("\n\n");
+}
+#endif
+
+static inline uint64_t timer_now(const struct chip8_t* chip8) {
+  return chip8->cycles * CHIP8_TIMER_HZ;
+}
+
+static inline uint8_t timer_value(const struct chip8_t* chip8,
+                                  uint64_t deadline) {
+  uint64_t now = timer_now(chip8);
+  return deadline > now
+           ? (uint8_t)((deadline - now + CHIP8_CYCLE_HZ - 1) / CHIP8_CYCLE_HZ)
+           : 0;
+}
+
+static inline uint64_t timer_deadline(const struct chip8_t* chip8,
+                                      uint8_t value) {
+  return timer_now(chip8) + (uint64_t)value * CHIP8_CYCLE_HZ;
+}
+
+static inline uint8_t chip8_random(struct chip8_t* chip8) {
+  // xorshift32, kept per machine so that runs are reproducible
+  uint32_t x = chip8->rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  chip8->rng = x;
+  return x >> 24;
+}
+
+/**
+ * Handlers taking their operands as arguments. The compiled blocks emitted
+ * by chip8-recompile call these with constants, so they never go through
+ * the decode fields in struct chip8_t.
+ */
+static inline void op_raw(struct chip8_t* chip8, uint16_t opcode) {
+  debug_printf("raw 0x%.4X", opcode);
+  chip8->pc += 2;
+}
+
+static inline void op_00E0(struct chip8_t* chip8) {
+  debug_printf("cls");
+  memset(chip8->gfx, 0, sizeof(chip8->gfx));
+  chip8->draw_flag = 1;
+  chip8->pc += 2;
+}
+
+static inline void op_00EE(struct chip8_t* chip8) {
+  debug_printf("ret");
+  chip8->pc = chip8->stack[--chip8->sp];
+}
+
+static inline void op_1NNN(struct chip8_t* chip8, uint16_t nnn) {
+  debug_printf("jp 0x%X", nnn);
+  chip8->pc = nnn;
+}
+
+static inline void op_2NNN(struct chip8_t* chip8, uint16_t nnn) {
+  debug_printf("call 0x%X", nnn);
+  chip8->stack[chip8->sp++] = chip8->pc + 2;
+  chip8->pc = nnn;
+}
+
+static inline void op_3XNN(struct chip8_t* chip8, uint8_t x, uint8_t nn) {
+  debug_printf("se v%d, 0x%X", x, nn);
+  chip8->pc += (chip8->V[x] == nn) ? 4 : 2;
+}
+
+static inline void op_4XNN(struct chip8_t* chip8, uint8_t x, uint8_t nn) {
+  debug_printf("sne v%d, 0x%X", x, nn);
+  chip8->pc += (chip8->V[x] != nn) ? 4 : 2;
+}
+
+static inline void op_5XY0(struct chip8_t* chip8, uint8_t x, uint8_t y) {
+  debug_printf("se v%d, v%d", x, y);
+  chip8->pc += (chip8->V[x] == chip8->V[y]) ? 4 : 2;
+}
+
+static inline void op_6XNN(struct chip8_t* chip8, uint8_t x, uint8_t nn) {
+  debug_printf("ld v%d, 0x%X", x, nn);
+  chip8->V[x] = nn;
+  chip8->pc += 2;
+}
+
+static inline void op_7XNN(struct chip8_t* chip8, uint8_t x, uint8_t nn) {
+  debug_printf("add v%d, 0x%X", x, nn);
+  chip8->V[x] += nn;
+  chip8->pc += 2;
+}
+
+static inline void op_8XY0(struct chip8_t* chip8, uint8_t x, uint8_t y) {
+  debug_printf("ld v%d, v%d", x, y);
+  chip8->V[x] = chip8->V[y];
+  chip8->pc += 2;
+}
+
+static inline void op_8XY1(struct chip8_t* chip8, uint8_t x, uint8_t y) {
+  debug_printf("or v%d, v%d", x, y);
+  chip8->V[x] |= chip8->V[y];
+  chip8->pc += 2;
+}
+
+static inline void op_8XY2(struct chip8_t* chip8, uint8_t x, uint8_t y) {
+  debug_printf("and v%d, v%d", x, y);
+  chip8->V[x] &= chip8->V[y];
+  chip8->pc += 2;
+}
+
+static inline void op_8XY3(struct chip8_t* chip8, uint8_t x, uint8_t y) {
+  debug_printf("xor v%d, v%d", x, y);
+  chip8->V[x] ^= chip8->V[y];
+  chip8->pc += 2;
+}
+
+static inline void op_8XY4(struct chip8_t* chip8, uint8_t x, uint8_t y) {
+  debug_printf("add v%d, v%d", x, y);
+  uint16_t added = (uint16_t)(((uint16_t)chip8->V[x]) +
+                              ((uint16_t)chip8->V[y]));
+  chip8->V[x] = added & 0xFF;
+  chip8->V[0xF] = (added & 0x0100) >> 8;
+  chip8->pc += 2;
+}
+
+static inline void op_8XY5(struct chip8_t* chip8, uint8_t x, uint8_t y) {
+  debug_printf("sub v%d, v%d", x, y);
+  if(chip8->V[x] > chip8->V[y]) {
+    chip8->V[0xF] = 1;
+  } else {
+    chip8->V[0xF] = 0;
+  }
+  chip8->V[x] -= chip8->V[y];
+  chip8->pc += 2;
+}
+
+static inline void op_8XY6(struct chip8_t* chip8, uint8_t x, uint8_t y) {
+  debug_printf("shr v%d", x);
+  chip8->V[0xF] = chip8->V[x] & 0x01;
+  chip8->V[x] >>= 1;
+  chip8->pc += 2;
+}
+
+static inline void op_8XY7(struct chip8_t* chip8, uint8_t x, uint8_t y) {
+  debug_printf("subn v%d, v%d", x, y);
+  if(chip8->V[x] < chip8->V[y]) {
+    chip8->V[0xF] = 1;
+  } else {
+    chip8->V[0xF] = 0;
+  }
+  chip8->V[x] = chip8->V[y] - chip8->V[x];
+  chip8->pc += 2;
+}
+
+static inline void op_8XYE(struct chip8_t* chip8, uint8_t x, uint8_t y) {
+  debug_printf("shl v%d", x);
+  chip8->V[0xF] = (chip8->V[x] * 0x80) >> 7;
+  chip8->V[x] <<= 1;
+  chip8->pc += 2;
+}
+
+static inline void op_9XY0(struct chip8_t* chip8, uint8_t x, uint8_t y) {
+  debug_printf("sne v%d, v%d", x, y);
+  chip8->pc += chip8->V[x] != chip8->V[y] ? 4 : 2;
+}
+
+static inline void op_ANNN(struct chip8_t* chip8, uint16_t nnn) {
+  debug_printf("ld I, 0x%x", nnn);
+  chip8->I = nnn;
+  chip8->pc += 2;
+}
+
+static inline void op_BNNN(struct chip8_t* chip8, uint16_t nnn) {
+  debug_printf("jp v0, 0x%x", nnn);
+  chip8->pc = chip8->V[0x0] + nnn;
+}
+
+static inline void op_CXNN(struct chip8_t* chip8, uint8_t x, uint8_t nn) {
+  debug_printf("rnd v%d, 0x%x", x, nn);
+  chip8->V[x] = chip8_random(chip8) & nn;
+  chip8->pc += 2;
+}
+
+static inline void op_DXYN(struct chip8_t* chip8, uint8_t x, uint8_t y,
+                           uint8_t n) {
+  debug_printf("drw v%d, v%d, 0x%x", x, y, n);
+  chip8->V[0xF] = 0;
+  uint8_t sx = chip8->V[x];
+  uint8_t sy = chip8->V[y];
+  uint8_t height = n;
+  for(uint8_t i = 0; i < height; i++) {
+    for(uint8_t j = 0; j < 8; j++) {
+      uint8_t pixel = (chip8->memory[chip8->I + (uint16_t)i] & (0x80 >> j));
+      uint8_t cx = sx + j;
+      uint8_t cy = sy + i;
+      if(cx >= CHIP8_DISPLAY_WIDTH || cy >= CHIP8_DISPLAY_HEIGHT) {
+        continue;
+      }
+      if(pixel) {
+        if(chip8->gfx[cy][cx] == CHIP8_DISPLAY_WHITE) {
+          chip8->V[0xF] = 1;
+        }
+        chip8->gfx[cy][cx] = chip8->gfx[cy][cx] == CHIP8_DISPLAY_WHITE
+                               ? CHIP8_DISPLAY_BLACK
+                               : CHIP8_DISPLAY_WHITE;
+      }
+    }
+  }
+  chip8->draw_flag = 1;
+  chip8->pc += 2;
+}
+
+static inline void op_EX9E(struct chip8_t* chip8, uint8_t x) {
+  debug_printf("skp v%d", x);
+  chip8->pc += chip8->keystate[chip8->V[x]] ? 4 : 2;
+}
+
+static inline void op_EXA1(struct chip8_t* chip8, uint8_t x) {
+  debug_printf("sknp v%d", x);
+  chip8->pc += !chip8->keystate[chip8->V[x]] ? 4 : 2;
+}
+
+static inline void op_FX07(struct chip8_t* chip8, uint8_t x) {
+  debug_printf("ld v%d, DT", x);
+  chip8->V[x] = timer_value(chip8, chip8->delay_deadline);
+  chip8->pc += 2;
+}
+
+static inline void op_FX0A(struct chip8_t* chip8, uint8_t x) {
+  debug_printf("ld v%d, K", x);
+  int keypressed = 0;
+  for(uint8_t i = 0; i < CHIP8_KEY_SIZE; i++) {
+    if(chip8->keystate[i]) {
+      chip8->V[x] = i;
+      keypressed = 1;
+    }
+  }
+  if(keypressed) {
+    chip8->pc += 2;
+  }
+}
+
+static inline void op_FX15(struct chip8_t* chip8, uint8_t x) {
+  debug_printf("ld DT, v%d", x);
+  chip8->delay_deadline = timer_deadline(chip8, chip8->V[x]);
+  chip8->pc += 2;
+}
+
+static inline void op_FX18(struct chip8_t* chip8, uint8_t x) {
+  debug_printf("ld ST, v%d", x);
+  chip8->sound_deadline = timer_deadline(chip8, chip8->V[x]);
+  chip8->pc += 2;
+}
+
+static inline void op_FX1E(struct chip8_t* chip8, uint8_t x) {
+  debug_printf("add I, v%d", x);
+  chip8->I += chip8->V[x];
+  chip8->pc += 2;
+}
+
+static inline void op_FX29(struct chip8_t* chip8, uint8_t x) {
+  debug_printf("ld F, v%d", x);
+  chip8->I = CHIP8_FONTSET_MEM_START + chip8->V[x] * 5;
+  chip8->pc += 2;
+}
+
+static inline void op_FX33(struct chip8_t* chip8, uint8_t x) {
+  debug_printf("ld B, v%d", x);
+  uint8_t value = chip8->V[x];
+  chip8->memory[chip8->I] = (value % 1000) / 100;
+  chip8->memory[chip8->I + 1] = (value % 100) / 10;
+  chip8->memory[chip8->I + 2] = (value % 10);
+  chip8->pc += 2;
+}
+
+static inline void op_FX55(struct chip8_t* chip8, uint8_t x) {
+  debug_printf("ld [I], v%d", x);
+  for(uint8_t i = 0; i <= x; i++) {
+    chip8->memory[chip8->I + i] = chip8->V[i];
+  }
+  chip8->pc += 2;
+}
+
+static inline void op_FX65(struct chip8_t* chip8, uint8_t x) {
+  debug_printf("ld v%d, [I]", x);
+  for(uint8_t i = 0; i <= x; i++) {
+    chip8->V[i] = chip8->memory[chip8->I + i];
+  }
+  chip8->pc += 2;
+}
+
+/**
+ * Handlers for the interpreters, reading the operands chip8_decode() left
+ * in chip8->D.
+ */
+static inline void opcode_raw(struct chip8_t* chip8) {
+  op_raw(chip8, chip8->opcode);
+}
+
+static inline void opcode_00E0(struct chip8_t* chip8) {
+  op_00E0(chip8);
+}
+
+static inline void opcode_00EE(struct chip8_t* chip8) {
+  op_00EE(chip8);
+}
+
+static inline void opcode_1NNN(struct chip8_t* chip8) {
+  op_1NNN(chip8, chip8->D.NNN);
+}
+
+static inline void opcode_2NNN(struct chip8_t* chip8) {
+  op_2NNN(chip8, chip8->D.NNN);
+}
+
+static inline void opcode_3XNN(struct chip8_t* chip8) {
+  op_3XNN(chip8, chip8->D.X, chip8->D.NN);
+}
+
+static inline void opcode_4XNN(struct chip8_t* chip8) {
+  op_4XNN(chip8, chip8->D.X, chip8->D.NN);
+}
+
+static inline void opcode_5XY0(struct chip8_t* chip8) {
+  op_5XY0(chip8, chip8->D.X, chip8->D.Y);
+}
+
+static inline void opcode_6XNN(struct chip8_t* chip8) {
+  op_6XNN(chip8, chip8->D.X, chip8->D.NN);
+}
+
+static inline void opcode_7XNN(struct chip8_t* chip8) {
+  op_7XNN(chip8, chip8->D.X, chip8->D.NN);
+}
+
+static inline void opcode_8XY0(struct chip8_t* chip8) {
+  op_8XY0(chip8, chip8->D.X, chip8->D.Y);
+}
+
+static inline void opcode_8XY1(struct chip8_t* chip8) {
+  op_8XY1(chip8, chip8->D.X, chip8->D.Y);
+}
+
+static inline void opcode_8XY2(struct chip8_t* chip8) {
+  op_8XY2(chip8, chip8->D.X, chip8->D.Y);
+}
+
+static inline void opcode_8XY3(struct chip8_t* chip8) {
+  op_8XY3(chip8, chip8->D.X, chip8->D.Y);
+}
+
+static inline void opcode_8XY4(struct chip8_t* chip8) {
+  op_8XY4(chip8, chip8->D.X, chip8->D.Y);
+}
+
+static inline void opcode_8XY5(struct chip8_t* chip8) {
+  op_8XY5(chip8, chip8->D.X, chip8->D.Y);
+}
+
+static inline void opcode_8XY6(struct chip8_t* chip8) {
+  op_8XY6(chip8, chip8->D.X, chip8->D.Y);
+}
+
+static inline void opcode_8XY7(struct chip8_t* chip8) {
+  op_8XY7(chip8, chip8->D.X, chip8->D.Y);
+}
+
+static inline void opcode_8XYE(struct chip8_t* chip8) {
+  op_8XYE(chip8, chip8->D.X, chip8->D.Y);
+}
+
+static inline void opcode_9XY0(struct chip8_t* chip8) {
+  op_9XY0(chip8, chip8->D.X, chip8->D.Y);
+}
+
+static inline void opcode_ANNN(struct chip8_t* chip8) {
+  op_ANNN(chip8, chip8->D.NNN);
+}
+
+static inline void opcode_BNNN(struct chip8_t* chip8) {
+  op_BNNN(chip8, chip8->D.NNN);
+}
+
+static inline void opcode_CXNN(struct chip8_t* chip8) {
+  op_CXNN(chip8, chip8->D.X, chip8->D.NN);
+}
+
+static inline void opcode_DXYN(struct chip8_t* chip8) {
+  op_DXYN(chip8, chip8->D.X, chip8->D.Y, chip8->D.N);
+}
+
+static inline void opcode_EX9E(struct chip8_t* chip8) {
+  op_EX9E(chip8, chip8->D.X);
+}
+
+static inline void opcode_EXA1(struct chip8_t* chip8) {
+  op_EXA1(chip8, chip8->D.X);
+}
+
+static inline void opcode_FX07(struct chip8_t* chip8) {
+  op_FX07(chip8, chip8->D.X);
+}
+
+static inline void opcode_FX0A(struct chip8_t* chip8) {
+  op_FX0A(chip8, chip8->D.X);
+}
+
+static inline void opcode_FX15(struct chip8_t* chip8) {
+  op_FX15(chip8, chip8->D.X);
+}
+
+static inline void opcode_FX18(struct chip8_t* chip8) {
+  op_FX18(chip8, chip8->D.X);
+}
+
+static inline void opcode_FX1E(struct chip8_t* chip8) {
+  op_FX1E(chip8, chip8->D.X);
+}
+
+static inline void opcode_FX29(struct chip8_t* chip8) {
+  op_FX29(chip8, chip8->D.X);
+}
+
+static inline void opcode_FX33(struct chip8_t* chip8) {
+  op_FX33(chip8, chip8->D.X);
+}
+
+static inline void opcode_FX55(struct chip8_t* chip8) {
+  op_FX55(chip8, chip8->D.X);
+}
+
+static inline void opcode_FX65(struct chip8_t* chip8) {
+  op_FX65(chip8, chip8->D.X);
+}
+
+static inline void chip8_decode(struct chip8_t* chip8, uint16_t opcode) {
+  chip8->opcode = opcode;
+  chip8->D.I = ((opcode & 0xF000u) >> 12);
+  chip8->D.X = ((opcode & 0x0F00u) >> 8);
+  chip8->D.Y = ((opcode & 0x00F0u) >> 4);
+  chip8->D.N = (opcode & 0x000Fu);
+  chip8->D.NN = (opcode & 0x00FFu);
+  chip8->D.NNN = (opcode & 0x0FFFu);
+}
+
+static inline void chip8_fetch_decode(struct chip8_t* chip8) {
+  chip8_decode(chip8, ((chip8->memory[chip8->pc] << 8) & 0xff00) |
+                        (chip8->memory[chip8->pc + 1] & 0xff));
+}
@@ -0,0 +1,318 @@
+#include "debugger.h"
+
+#include "aot.h"
+
+#include <SDL2/SDL.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BITMAP_TEST(bitmap, addr) ((bitmap)[(addr) >> 3] & (1 << ((addr)&7)))
+#define BITMAP_SET(bitmap, addr) ((bitmap)[(addr) >> 3] |= 1 << ((addr)&7))
+
+#define CONDITION_REGISTER_I CHIP8_REGISTER_SIZE
+
+enum condition_op_t { OP_EQ, OP_NE, OP_LE, OP_GE, OP_LT, OP_GT };
+
+struct condition_t {
+  int reg;
+  enum condition_op_t op;
+  unsigned long value;
+  int last;
+};
+
+static uint8_t breakpoints[CHIP8_MEMORY_SIZE / 8];
+static uint8_t watchpoints[CHIP8_MEMORY_SIZE / 8];
+static int breakpoint_count;
+static int watchpoint_count;
+static struct condition_t conditions[DEBUGGER_MAX_CONDITIONS];
+static int condition_count;
+// set after stopping on a breakpoint so that continuing executes it
+static int resume_pc = -1;
+
+// async dumps: the emulator copies the machine into the queue and the
+// writer thread formats it into dump_fp
+static SDL_Thread* writer;
+static SDL_mutex* dump_lock;
+static SDL_cond* dump_ready;
+static struct chip8_t dump_queue[DEBUGGER_DUMP_QUEUE];
+static int dump_head, dump_count, dump_quit;
+static FILE* dump_fp;
+static const char* dump_path;
+
+static int dump_writer(void* data) {
+  static struct chip8_t snapshot;
+  SDL_LockMutex(dump_lock);
+  for(;;) {
+    while(!dump_quit && dump_count == 0) {
+      SDL_CondWait(dump_ready, dump_lock);
+    }
+    if(dump_count == 0) {
+      break;
+    }
+    snapshot = dump_queue[dump_head];
+    dump_head = (dump_head + 1) % DEBUGGER_DUMP_QUEUE;
+    dump_count--;
+    SDL_UnlockMutex(dump_lock);
+
+    fprintf(dump_fp, "\n==== cycle %llu ====",
+            (unsigned long long)snapshot.cycles);
+    chip8_dump_pc(&snapshot, dump_fp);
+    chip8_dump_register(&snapshot, dump_fp);
+    chip8_dump_memory(&snapshot, dump_fp);
+    fflush(dump_fp);
+
+    SDL_LockMutex(dump_lock);
+  }
+  SDL_UnlockMutex(dump_lock);
+  return 0;
+}
+
+/**
+ * Only records where dumps go; the file is opened and the writer started
+ * by the first dump, so a session that never dumps leaves no file behind.
+ */
+void debugger_init(const char* dump_file) {
+  dump_path = dump_file;
+}
+
+static int writer_start() {
+  dump_fp = fopen(dump_path, "a");
+  if(!dump_fp) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "can't open file: '%s'",
+                 dump_path);
+    return 0;
+  }
+  dump_quit = 0;
+  dump_lock = SDL_CreateMutex();
+  dump_ready = SDL_CreateCond();
+  writer = dump_lock && dump_ready
+             ? SDL_CreateThread(dump_writer, "chip8 dump", NULL)
+             : NULL;
+  if(!writer) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateThread() Error: %s",
+                 SDL_GetError());
+    debugger_destroy();
+    return 0;
+  }
+  return 1;
+}
+
+void debugger_destroy() {
+  if(writer) {
+    SDL_LockMutex(dump_lock);
+    dump_quit = 1;
+    SDL_CondSignal(dump_ready);
+    SDL_UnlockMutex(dump_lock);
+    SDL_WaitThread(writer, NULL);
+    writer = NULL;
+  }
+  if(dump_ready) {
+    SDL_DestroyCond(dump_ready);
+    dump_ready = NULL;
+  }
+  if(dump_lock) {
+    SDL_DestroyMutex(dump_lock);
+    dump_lock = NULL;
+  }
+  if(dump_fp) {
+    fclose(dump_fp);
+    dump_fp = NULL;
+  }
+}
+
+void debugger_dump(const struct chip8_t* chip8) {
+  if(!writer && !writer_start()) {
+    SDL_Log("dump writer is not available, dropping dump");
+    return;
+  }
+  SDL_LockMutex(dump_lock);
+  if(dump_count < DEBUGGER_DUMP_QUEUE) {
+    dump_queue[(dump_head + dump_count) % DEBUGGER_DUMP_QUEUE] = *chip8;
+    dump_count++;
+    SDL_CondSignal(dump_ready);
+  } else {
+    SDL_Log("dump queue is full, dropping dump");
+  }
+  SDL_UnlockMutex(dump_lock);
+}
+
+int debugger_break_pc(uint16_t addr) {
+  if(addr >= CHIP8_MEMORY_SIZE) {
+    return 0;
+  }
+  if(!BITMAP_TEST(breakpoints, addr)) {
+    BITMAP_SET(breakpoints, addr);
+    breakpoint_count++;
+  }
+  return 1;
+}
+
+int debugger_watch(uint16_t addr, uint16_t len) {
+  if(len == 0 || addr + len > CHIP8_MEMORY_SIZE) {
+    return 0;
+  }
+  for(uint16_t i = addr; i < addr + len; i++) {
+    BITMAP_SET(watchpoints, i);
+  }
+  watchpoint_count++;
+  return 1;
+}
+
+int debugger_break_if(const char* expr) {
+  static const struct {
+    const char* text;
+    enum condition_op_t op;
+  } OPS[] = {
+    {"==", OP_EQ}, {"!=", OP_NE}, {"<=", OP_LE},
+    {">=", OP_GE}, {"<", OP_LT},  {">", OP_GT}
+  };
+  if(condition_count == DEBUGGER_MAX_CONDITIONS) {
+    return 0;
+  }
+  struct condition_t condition = {0, OP_EQ, 0, 0};
+  const char* p = expr;
+  if((p[0] == 'V' || p[0] == 'v') && p[1] != '\0' &&
+     strchr("0123456789abcdefABCDEF", p[1])) {
+    char digit[2] = {p[1], '\0'};
+    condition.reg = (int)strtol(digit, NULL, 16);
+    p += 2;
+  } else if(p[0] == 'I' || p[0] == 'i') {
+    condition.reg = CONDITION_REGISTER_I;
+    p += 1;
+  } else {
+    return 0;
+  }
+  size_t i = 0;
+  for(; i < sizeof(OPS) / sizeof(OPS[0]); i++) {
+    if(strncmp(p, OPS[i].text, strlen(OPS[i].text)) == 0) {
+      condition.op = OPS[i].op;
+      p += strlen(OPS[i].text);
+      break;
+    }
+  }
+  if(i == sizeof(OPS) / sizeof(OPS[0])) {
+    return 0;
+  }
+  char* end;
+  condition.value = strtoul(p, &end, 0);
+  if(end == p || *end != '\0') {
+    return 0;
+  }
+  conditions[condition_count++] = condition;
+  return 1;
+}
+
+int debugger_armed() {
+  return breakpoint_count || watchpoint_count || condition_count;
+}
+
+static int condition_holds(const struct chip8_t* chip8,
+                           const struct condition_t* condition) {
+  unsigned long value = condition->reg == CONDITION_REGISTER_I
+                          ? chip8->I
+                          : chip8->V[condition->reg];
+  switch(condition->op) {
+    case OP_EQ:
+      return value == condition->value;
+    case OP_NE:
+      return value != condition->value;
+    case OP_LE:
+      return value <= condition->value;
+    case OP_GE:
+      return value >= condition->value;
+    case OP_LT:
+      return value < condition->value;
+    case OP_GT:
+      return value > condition->value;
+  }
+  return 0;
+}
+
+static int watch_hit(const struct chip8_t* chip8) {
+  // FX33 and FX55 are the only instructions that write memory
+  uint16_t len;
+  if((chip8->opcode & 0xF0FF) == 0xF033) {
+    len = 3;
+  } else if((chip8->opcode & 0xF0FF) == 0xF055) {
+    // compiled code sets opcode but not the decode scratch D
+    len = ((chip8->opcode >> 8) & 0xF) + 1;
+  } else {
+    return 0;
+  }
+  for(uint16_t i = 0; i < len && chip8->I + i < CHIP8_MEMORY_SIZE; i++) {
+    if(BITMAP_TEST(watchpoints, chip8->I + i)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void debugger_disassemble(const struct chip8_t* chip8, uint16_t addr,
+                          int count) {
+  for(int i = 0; i < count && addr + 1 < CHIP8_MEMORY_SIZE; i++, addr += 2) {
+    uint16_t opcode = chip8->memory[addr] << 8 | chip8->memory[addr + 1];
+    char text[32];
+    chip8_disassemble(opcode, text, sizeof(text));
+    printf("%c%c 0x%.4X: %.4X  %s\n", addr == chip8->pc ? '>' : ' ',
+           BITMAP_TEST(breakpoints, addr) ? '*' : ' ', addr, opcode, text);
+  }
+}
+
+static void debugger_stop(struct chip8_t* chip8, const char* reason) {
+  printf("\n%s at pc 0x%.4X (cycle %llu)\n", reason, chip8->pc,
+         (unsigned long long)chip8->cycles);
+  chip8_dump_register(chip8, stdout);
+  uint16_t from = chip8->pc >= 8 ? chip8->pc - 8 : 0;
+  debugger_disassemble(chip8, from, 9);
+  chip8->state = CHIP8_STATE_PAUSED;
+}
+
+/**
+ * Executes one instruction and reports whether a watchpoint or condition
+ * fired. Breakpoints are checked by the caller before the instruction.
+ * The instruction goes through aot_run(), so a loaded compiled rom keeps
+ * running and writes over its code invalidate the affected blocks.
+ */
+static int debugger_execute(struct chip8_t* chip8) {
+  aot_run(chip8, chip8->cycles + 1);
+  if(watchpoint_count && watch_hit(chip8)) {
+    debugger_stop(chip8, "watchpoint hit");
+    return 1;
+  }
+  int stop = 0;
+  for(int i = 0; i < condition_count; i++) {
+    int holds = condition_holds(chip8, &conditions[i]);
+    if(holds && !conditions[i].last) {
+      stop = 1;
+    }
+    conditions[i].last = holds;
+  }
+  if(stop) {
+    debugger_stop(chip8, "condition met");
+  }
+  return stop;
+}
+
+void debugger_run(struct chip8_t* chip8, uint64_t cycles) {
+  while(chip8->cycles < cycles) {
+    if(chip8->pc < CHIP8_MEMORY_SIZE &&
+       BITMAP_TEST(breakpoints, chip8->pc) && chip8->pc != resume_pc) {
+      resume_pc = chip8->pc;
+      debugger_stop(chip8, "breakpoint");
+      return;
+    }
+    resume_pc = -1;
+    if(debugger_execute(chip8)) {
+      return;
+    }
+  }
+}
+
+void debugger_step(struct chip8_t* chip8) {
+  resume_pc = -1;
+  debugger_execute(chip8);
+  chip8_dump_register(chip8, stdout);
+  debugger_disassemble(chip8, chip8->pc, 1);
+}
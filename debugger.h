@@ -0,0 +1,37 @@
+#pragma once
+
+#include "chip8.h"
+
+/**
+ * Breakpoints, watchpoints and conditional breaks. None of this touches
+ * the normal execution path: main() only switches from aot_run() to
+ * debugger_run() while debugger_armed() is true. debugger_run() still
+ * executes through aot_run(), one instruction at a time, so a compiled rom
+ * stays in use; it just does not run whole blocks.
+ *
+ * Condition expressions compare a register with a value, e.g. "V3==0x10",
+ * "VF!=0" or "I>=0x300"; the break fires when the condition becomes true.
+ */
+#define DEBUGGER_MAX_CONDITIONS 16
+#define DEBUGGER_DUMP_QUEUE 4
+
+void debugger_init(const char* dump_file);
+
+void debugger_destroy();
+
+int debugger_break_pc(uint16_t addr);
+
+int debugger_watch(uint16_t addr, uint16_t len);
+
+int debugger_break_if(const char* expr);
+
+int debugger_armed();
+
+void debugger_run(struct chip8_t* chip8, uint64_t cycles);
+
+void debugger_step(struct chip8_t* chip8);
+
+void debugger_disassemble(const struct chip8_t* chip8, uint16_t addr,
+                          int count);
+
+void debugger_dump(const struct chip8_t* chip8);
@@ -1,15 +1,84 @@
 #define SDL_MAIN_HANDLED
 
+#include "aot.h"
 #include "chip8.h"
+#include "debugger.h"
 #include "port.h"
+#include "scaler.h"
 
 #include <SDL2/SDL.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage() {
+  printf(
+    "Usage: chip8-emulator [--break <addr>] [--watch <addr>[:len]] "
+    "[--break-if <expr>] [--dump-file <file>] [--filter <nearest|scale2x>] "
+    "[--scanlines] [--phosphor] [--software] <rom file> [compiled rom]");
+}
 
 int main(int argc, char const *argv[]) {
-  if(argc < 2) {
-    printf("Usage: chip8-emulator <rom file>");
+  const char *dump_file = "chip8-dump.txt";
+  int filter = SCALER_NEAREST, effects = 0, software = 0;
+  int arg = 1;
+  for(; arg < argc && argv[arg][0] == '-'; arg++) {
+    const char *option = argv[arg];
+    char *end;
+    int ok;
+    if(strcmp(option, "--scanlines") == 0) {
+      effects |= SCALER_SCANLINES;
+      continue;
+    } else if(strcmp(option, "--phosphor") == 0) {
+      effects |= SCALER_PHOSPHOR;
+      continue;
+    } else if(strcmp(option, "--software") == 0) {
+      software = 1;
+      continue;
+    } else if(arg + 1 == argc) {
+      fprintf(stderr, "missing value for option: '%s'\n", option);
+      usage();
+      return EXIT_FAILURE;
+    }
+    const char *value = argv[++arg];
+    if(strcmp(option, "--break") == 0) {
+      unsigned long addr = strtoul(value, &end, 0);
+      // range-check before narrowing, or 0x10200 would break at 0x0200
+      ok = end != value && *end == '\0' && addr < CHIP8_MEMORY_SIZE &&
+           debugger_break_pc((uint16_t)addr);
+    } else if(strcmp(option, "--watch") == 0) {
+      unsigned long addr = strtoul(value, &end, 0);
+      ok = end != value;
+      unsigned long len = *end == ':' ? strtoul(end + 1, &end, 0) : 1;
+      ok = ok && *end == '\0' && addr < CHIP8_MEMORY_SIZE && len > 0 &&
+           len <= CHIP8_MEMORY_SIZE - addr &&
+           debugger_watch((uint16_t)addr, (uint16_t)len);
+    } else if(strcmp(option, "--break-if") == 0) {
+      ok = debugger_break_if(value);
+    } else if(strcmp(option, "--dump-file") == 0) {
+      dump_file = value;
+      ok = 1;
+    } else if(strcmp(option, "--filter") == 0) {
+      ok = 1;
+      if(strcmp(value, "nearest") == 0) {
+        filter = SCALER_NEAREST;
+      } else if(strcmp(value, "scale2x") == 0) {
+        filter = SCALER_SCALE2X;
+      } else {
+        ok = 0;
+      }
+    } else {
+      ok = 0;
+    }
+    if(!ok) {
+      fprintf(stderr, "invalid option: '%s %s'\n", option, value);
+      usage();
+      return EXIT_FAILURE;
+    }
+  }
+  if(arg >= argc) {
+    usage();
     return EXIT_FAILURE;
   }
 
@@ -18,7 +87,8 @@ int main(int argc, char const *argv[]) {
     return EXIT_FAILURE;
   }
 
-  if(!display_init("Chip-8 Emulator", CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT, CHIP8_DISPLAY_SCALE)) {
+  if(!display_init("Chip-8 Emulator", CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT, CHIP8_DISPLAY_SCALE,
+                   filter, effects, software)) {
     return EXIT_FAILURE;
   }
 
@@ -26,36 +96,47 @@ int main(int argc, char const *argv[]) {
     return EXIT_FAILURE;
   }
 
+  debugger_init(dump_file);
+
   struct chip8_t chip8;
 
   chip8_init(&chip8);
-  if(!chip8_load_program(&chip8, argv[1])) {
+  if(!chip8_load_program(&chip8, argv[arg])) {
     return EXIT_FAILURE;
   }
 
-  Uint32 last_cycle_time = SDL_GetTicks();
-  Uint32 last_timer_time = SDL_GetTicks();
+  if(arg + 1 < argc && !aot_load(argv[arg + 1], &chip8)) {
+    return EXIT_FAILURE;
+  }
+
+  Uint32 last_frame_time = SDL_GetTicks();
 
   while(chip8.state != CHIP8_STATE_QUIT) {
     keyboard_handle(&chip8);
     if(chip8.state == CHIP8_STATE_PAUSED) {
       continue;
     }
-    if(SDL_GetTicks() - last_cycle_time >= CYCLE_DELAY) {
-      last_cycle_time = SDL_GetTicks();
-      chip8_cricle(&chip8);
-      if(SDL_GetTicks() - last_timer_time >= TIMER_DELAY) {
-        last_timer_time = SDL_GetTicks();
-        timer_handle(&chip8);
-        sound_handle(&chip8);
-      }      
-    }
-    if(chip8.draw_flag) {
+    // a frame's worth of instructions at a time, so compiled blocks can run
+    // whole; without a compiled rom aot_run() just interprets. Breakpoints
+    // need per-instruction checks, so they get their own loop that steps
+    // the same engine one instruction at a time
+    if(SDL_GetTicks() - last_frame_time >= TIMER_DELAY) {
+      last_frame_time = SDL_GetTicks();
+      if(debugger_armed()) {
+        debugger_run(&chip8, chip8.cycles + CHIP8_CYCLES_PER_FRAME);
+      } else {
+        aot_run(&chip8, chip8.cycles + CHIP8_CYCLES_PER_FRAME);
+      }
+      sound_handle(&chip8);
+      // redraws only the rows that changed, and keeps presenting while
+      // phosphor decay fades out
       display_handle(&chip8);
       chip8.draw_flag = 0;
     }
   }
 
+  aot_unload();
+  debugger_destroy();
   display_destroy();
   sound_destroy();
   SDL_Quit();
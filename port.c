@@ -1,5 +1,7 @@
 #include "port.h"
 #include "chip8.h"
+#include "debugger.h"
+#include "scaler.h"
 
 #include <SDL2/SDL.h>
 
@@ -8,6 +10,7 @@
 static SDL_Window* window;
 static SDL_Renderer* renderer;
 static SDL_Texture* texture;
+static struct scaler_t scaler;
 
 /**
 Keypad       Keyboard
@@ -40,7 +43,33 @@ static uint8_t KEY_MAP[CHIP8_KEY_SIZE] = {
   SDLK_v   // F
 };
 
-int display_init(const char* title, int width, int height, int scale) {
+static int display_palette(Uint32 format, uint32_t palette[SCALER_LEVELS]) {
+  SDL_PixelFormat* pixel_format = SDL_AllocFormat(format);
+  if(!pixel_format) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_AllocFormat() Error: %s", SDL_GetError());
+    return 0;
+  }
+  int supported = pixel_format->BytesPerPixel == 4;
+  if(supported) {
+    for(int i = 0; i < SCALER_LEVELS; i++) {
+      palette[i] = SDL_MapRGB(pixel_format, i, i, i);
+    }
+  } else {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "unsupported pixel format: %s",
+                 SDL_GetPixelFormatName(format));
+  }
+  SDL_FreeFormat(pixel_format);
+  return supported;
+}
+
+/**
+ * The display is scaled on the CPU by scaler.c and written straight into
+ * a streaming texture of the window's size, so the renderer only copies it
+ * 1:1. Without an accelerated renderer (or with 'software' set) the scaler
+ * draws directly into the window surface instead.
+ */
+int display_init(const char* title, int width, int height, int scale,
+                 int filter, int effects, int software) {
   window = SDL_CreateWindow(title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
                      width * scale, height * scale, SDL_WINDOW_SHOWN);
   if(!window) {
@@ -49,20 +78,41 @@ int display_init(const char* title, int width, int height, int scale) {
     return 0;
   }
 
-  renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-  if(!renderer) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateRenderer() Error: %s", SDL_GetError());
-    SDL_DestroyWindow(window);
-    SDL_Quit();
-    return 0;
+  if(!software) {
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    if(!renderer) {
+      SDL_Log("no accelerated renderer (%s), drawing into the window surface",
+              SDL_GetError());
+    }
   }
 
-  texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
-                              SDL_TEXTUREACCESS_STREAMING, width, height);
-  if(!texture) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateTexture() Error: %s", SDL_GetError());
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
+  Uint32 format;
+  if(renderer) {
+    format = SDL_PIXELFORMAT_ARGB8888;
+    texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STREAMING,
+                                width * scale, height * scale);
+    if(!texture) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateTexture() Error: %s", SDL_GetError());
+      display_destroy();
+      SDL_Quit();
+      return 0;
+    }
+  } else {
+    SDL_Surface* surface = SDL_GetWindowSurface(window);
+    if(!surface) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_GetWindowSurface() Error: %s", SDL_GetError());
+      display_destroy();
+      SDL_Quit();
+      return 0;
+    }
+    format = surface->format->format;
+  }
+
+  uint32_t palette[SCALER_LEVELS];
+  if(!display_palette(format, palette) ||
+     !scaler_init(&scaler, scale, filter, effects, palette)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "can't scale the display by %d", scale);
+    display_destroy();
     SDL_Quit();
     return 0;
   }
@@ -70,17 +120,57 @@ int display_init(const char* title, int width, int height, int scale) {
   return 1;
 }
 
+/**
+ * Redraws the rows that changed since the last call; a no-op when nothing
+ * did, so it is safe to call every frame.
+ */
 void display_handle(struct chip8_t* chip8) {
-  SDL_UpdateTexture(texture, NULL, chip8->gfx, sizeof(chip8->gfx[0]));
-  SDL_RenderClear(renderer);
-  SDL_RenderCopy(renderer, texture, NULL, NULL);
-  SDL_RenderPresent(renderer);
+  int first;
+  int count = scaler_update(&scaler, chip8, &first);
+  if(!count) {
+    return;
+  }
+  int scale = scaler.scale;
+  SDL_Rect rect = {0, first * scale, CHIP8_DISPLAY_WIDTH * scale, count * scale};
+
+  if(renderer) {
+    void* pixels;
+    int pitch;
+    if(SDL_LockTexture(texture, &rect, &pixels, &pitch)) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_LockTexture() Error: %s", SDL_GetError());
+      scaler_invalidate(&scaler);
+      return;
+    }
+    scaler_render(&scaler, first, count, pixels, pitch);
+    SDL_UnlockTexture(texture);
+    SDL_RenderCopy(renderer, texture, NULL, NULL);
+    SDL_RenderPresent(renderer);
+    return;
+  }
+
+  SDL_Surface* surface = SDL_GetWindowSurface(window);
+  if(!surface || (SDL_MUSTLOCK(surface) && SDL_LockSurface(surface))) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "can't draw into the window surface: %s", SDL_GetError());
+    scaler_invalidate(&scaler);
+    return;
+  }
+  scaler_render(&scaler, first, count,
+                (uint32_t*)((uint8_t*)surface->pixels + rect.y * surface->pitch),
+                surface->pitch);
+  if(SDL_MUSTLOCK(surface)) {
+    SDL_UnlockSurface(surface);
+  }
+  SDL_UpdateWindowSurfaceRects(window, &rect, 1);
 }
 
 void display_destroy() {
+  if(texture) {
+    SDL_DestroyTexture(texture);
+  }
+  if(renderer) {
+    SDL_DestroyRenderer(renderer);
+  }
   SDL_DestroyWindow(window);
-  SDL_DestroyRenderer(renderer);
-  SDL_DestroyTexture(texture);
 }
 
 static int print_dump_on = 1;
@@ -91,6 +181,11 @@ void keyboard_handle(struct chip8_t* chip8) {
     if(event.type == SDL_QUIT) {
       chip8->state = CHIP8_STATE_QUIT;
       return;
+    } else if(event.type == SDL_WINDOWEVENT) {
+      if(event.window.event == SDL_WINDOWEVENT_EXPOSED) {
+        scaler_invalidate(&scaler);
+        display_handle(chip8);
+      }
     } else if(event.type == SDL_KEYDOWN) {
       if(event.key.keysym.sym == SDLK_ESCAPE) {
         chip8->state = CHIP8_STATE_QUIT;
@@ -100,11 +195,19 @@ void keyboard_handle(struct chip8_t* chip8) {
                                                           : CHIP8_STATE_PAUSED;
       } else if(event.key.keysym.sym == SDLK_p) {
         if(print_dump_on) {
-          chip8_dump_pc(chip8);
-          chip8_dump_register(chip8);
-          chip8_dump_memory(chip8);
+          debugger_dump(chip8);
           print_dump_on = 0;
         }
+      } else if(event.key.keysym.sym == SDLK_F10) {
+        if(chip8->state == CHIP8_STATE_PAUSED) {
+          debugger_step(chip8);
+          if(chip8->draw_flag) {
+            display_handle(chip8);
+            chip8->draw_flag = 0;
+          }
+        }
+      } else if(event.key.keysym.sym == SDLK_F5) {
+        chip8->state = CHIP8_STATE_PLAYING;
       } else {
         for(int i = 0; i < CHIP8_KEY_SIZE; i++) {
           if(event.key.keysym.sym == KEY_MAP[i]) {
@@ -162,8 +265,7 @@ int sound_init() {
 }
 
 void sound_handle(struct chip8_t* chip8) {
-  if(chip8->sound_timer > 0) {
-    chip8->sound_timer--;
+  if(chip8_sound_timer(chip8) > 0) {
     SDL_PauseAudioDevice(audio_device, 0);
   } else {
     SDL_PauseAudioDevice(audio_device, 1);
@@ -173,9 +275,3 @@ void sound_handle(struct chip8_t* chip8) {
 void sound_destroy() {
   SDL_CloseAudioDevice(audio_device);
 }
-
-void timer_handle(struct chip8_t* chip8) {
-  if(chip8->delay_timer > 0) {
-    chip8->delay_timer--;
-  }
-}
\ No newline at end of file
@@ -2,7 +2,8 @@
 
 struct chip8_t;
 
-int display_init(const char* title, int width, int height, int scale);
+int display_init(const char* title, int width, int height, int scale,
+                 int filter, int effects, int software);
 
 void display_handle(struct chip8_t* chip8);
 
@@ -14,6 +15,4 @@ int sound_init();
 
 void sound_handle(struct chip8_t* chip8);
 
-void sound_destroy();
-
-void timer_handle(struct chip8_t* chip8);
\ No newline at end of file
+void sound_destroy();
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "scaler.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCALER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SCALER_NEON
+#endif
+
+// grey level a pixel starts fading from when it is switched off, and how
+// much of it is kept each frame (out of 256)
+#define PHOSPHOR_START 0xA0
+#define PHOSPHOR_DECAY 0xA0
+// brightness of scanline rows (out of 256)
+#define SCANLINE_LEVEL 0xA0
+
+#define ROW_BIT(row, x) ((unsigned)((row) >> (x)) & 1)
+
+int scaler_init(struct scaler_t* scaler, int scale, int filter, int effects,
+                const uint32_t palette[SCALER_LEVELS]) {
+  if(scale < 1 || scale > SCALER_MAX_SCALE ||
+     (filter == SCALER_SCALE2X && scale < 2)) {
+    return 0;
+  }
+  memset(scaler, 0, sizeof(*scaler));
+  scaler->scale = scale;
+  scaler->filter = filter;
+  scaler->effects = effects;
+  for(int i = 0; i < SCALER_LEVELS; i++) {
+    scaler->palette[i] = palette[i];
+    scaler->dim[i] = palette[i * SCANLINE_LEVEL >> 8];
+  }
+  return 1;
+}
+
+/**
+ * Forces the next update to redraw every row, e.g. after the destination
+ * lost its contents.
+ */
+void scaler_invalidate(struct scaler_t* scaler) {
+  scaler->valid = 0;
+}
+
+static uint64_t pack_row(const uint32_t* row) {
+  uint64_t mask = 0;
+  int x = 0;
+#if defined(SCALER_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  for(; x + 4 <= CHIP8_DISPLAY_WIDTH; x += 4) {
+    __m128i unlit =
+      _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(row + x)), zero);
+    uint64_t lit = ~_mm_movemask_ps(_mm_castsi128_ps(unlit)) & 0xF;
+    mask |= lit << x;
+  }
+#endif
+  for(; x < CHIP8_DISPLAY_WIDTH; x++) {
+    mask |= (uint64_t)(row[x] != 0) << x;
+  }
+  return mask;
+}
+
+/**
+ * Packs the display and advances the phosphor decay. Returns the number of
+ * rows in the band that needs redrawing and stores its first row in
+ * 'first'; 0 means the destination is already up to date.
+ */
+int scaler_update(struct scaler_t* scaler, const struct chip8_t* chip8,
+                  int* first) {
+  uint32_t changed = 0, fading = 0;
+  for(int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
+    uint64_t row = pack_row(chip8->gfx[y]);
+    uint64_t before = scaler->rows[y];
+    if(!scaler->valid || row != before) {
+      changed |= 1u << y;
+    }
+    if((scaler->effects & SCALER_PHOSPHOR) &&
+       ((scaler->fading >> y & 1) || (before & ~row))) {
+      uint8_t* fade = scaler->fade[y];
+      unsigned any = 0;
+      for(int x = 0; x < CHIP8_DISPLAY_WIDTH; x++) {
+        if(ROW_BIT(row, x)) {
+          fade[x] = 0;
+        } else if(ROW_BIT(before, x)) {
+          fade[x] = PHOSPHOR_START;
+        } else {
+          fade[x] = fade[x] * PHOSPHOR_DECAY >> 8;
+        }
+        any |= fade[x];
+      }
+      if(any) {
+        fading |= 1u << y;
+      }
+    }
+    scaler->rows[y] = row;
+  }
+
+  uint32_t dirty = changed | fading | scaler->fading;
+  if(scaler->filter == SCALER_SCALE2X) {
+    // Scale2x output depends on the rows above and below
+    dirty |= changed << 1 | changed >> 1;
+  }
+  scaler->fading = fading;
+  scaler->valid = 1;
+  if(!dirty) {
+    return 0;
+  }
+  int last = CHIP8_DISPLAY_HEIGHT - 1;
+  while(!(dirty >> last & 1)) {
+    last--;
+  }
+  *first = 0;
+  while(!(dirty >> *first & 1)) {
+    (*first)++;
+  }
+  return last - *first + 1;
+}
+
+/**
+ * Fills n pixels with one color. Spans of 4 pixels or more end with an
+ * overlapping vector store instead of a scalar tail.
+ */
+static inline void fill_span(uint32_t* dst, uint32_t color, int n) {
+#if defined(SCALER_SSE2) || defined(SCALER_NEON)
+  if(n >= 4) {
+#if defined(SCALER_SSE2)
+    __m128i v = _mm_set1_epi32((int)color);
+    for(int i = 0; i < n - 4; i += 4) {
+      _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+    _mm_storeu_si128((__m128i*)(dst + n - 4), v);
+#else
+    uint32x4_t v = vdupq_n_u32(color);
+    for(int i = 0; i < n - 4; i += 4) {
+      vst1q_u32(dst + i, v);
+    }
+    vst1q_u32(dst + n - 4, v);
+#endif
+    return;
+  }
+#endif
+  for(int i = 0; i < n; i++) {
+    dst[i] = color;
+  }
+}
+
+/**
+ * Expands one display row into an output line. 'left' and 'right' select
+ * which halves of each cell are lit; for nearest neighbor both are the row
+ * itself. Unlit cells show their phosphor fade level.
+ */
+static void build_line(uint32_t* line, const uint32_t* palette, uint64_t row,
+                       uint64_t left, uint64_t right, const uint8_t* fade,
+                       int scale) {
+  int split = scale / 2;
+  for(int x = 0; x < CHIP8_DISPLAY_WIDTH; x++, line += scale) {
+    // an unlit half of a lit pixel is a corner Scale2x cut off
+    int base = ROW_BIT(row, x) ? 0 : fade[x];
+    int l = ROW_BIT(left, x) ? SCALER_LEVELS - 1 : base;
+    int r = ROW_BIT(right, x) ? SCALER_LEVELS - 1 : base;
+    if(l == r) {
+      fill_span(line, palette[l], scale);
+    } else {
+      fill_span(line, palette[l], split);
+      fill_span(line + split, palette[r], scale - split);
+    }
+  }
+}
+
+/**
+ * Writes display rows first..first+count-1 to 'pixels', which points at the
+ * first output line of row 'first' and advances by 'pitch' bytes per line.
+ */
+void scaler_render(struct scaler_t* scaler, int first, int count,
+                   uint32_t* pixels, int pitch) {
+  static const uint8_t NO_FADE[CHIP8_DISPLAY_WIDTH];
+  int scale = scaler->scale;
+  size_t width = CHIP8_DISPLAY_WIDTH * scale * sizeof(uint32_t);
+  int scanlines = scaler->effects & SCALER_SCANLINES ? scale / 4 : 0;
+  uint8_t* out = (uint8_t*)pixels;
+
+  for(int y = first; y < first + count; y++) {
+    uint64_t p = scaler->rows[y];
+    const uint8_t* fade =
+      scaler->effects & SCALER_PHOSPHOR ? scaler->fade[y] : NO_FADE;
+    // halves of the cell: [top, bottom) output lines and their masks
+    int halves = 1;
+    int top[2] = {0, scale / 2}, bottom[2] = {scale, scale};
+    uint64_t left[2] = {p, p}, right[2] = {p, p};
+
+    if(scaler->filter == SCALER_SCALE2X) {
+      // EPX on 64 pixels at once: bit x of each mask is pixel x, neighbors
+      // outside the display repeat the edge
+      uint64_t a = y > 0 ? scaler->rows[y - 1] : p;
+      uint64_t d = y < CHIP8_DISPLAY_HEIGHT - 1 ? scaler->rows[y + 1] : p;
+      uint64_t c = p << 1 | (p & 1);
+      uint64_t b = p >> 1 | (p & (1ull << 63));
+      uint64_t e0 = ~(c ^ a) & (c ^ d) & (a ^ b);
+      uint64_t e1 = ~(a ^ b) & (a ^ c) & (b ^ d);
+      uint64_t e2 = ~(d ^ c) & (d ^ b) & (c ^ a);
+      uint64_t e3 = ~(b ^ d) & (b ^ a) & (d ^ c);
+      halves = 2;
+      bottom[0] = scale / 2;
+      left[0] = (e0 & a) | (~e0 & p);
+      right[0] = (e1 & b) | (~e1 & p);
+      left[1] = (e2 & c) | (~e2 & p);
+      right[1] = (e3 & d) | (~e3 & p);
+    }
+
+    for(int h = 0; h < halves; h++) {
+      build_line(scaler->line, scaler->palette, p, left[h], right[h], fade,
+                 scale);
+      if(bottom[h] > scale - scanlines) {
+        build_line(scaler->dim_line, scaler->dim, p, left[h], right[h], fade,
+                   scale);
+      }
+      for(int r = top[h]; r < bottom[h]; r++, out += pitch) {
+        memcpy(out, r < scale - scanlines ? scaler->line : scaler->dim_line,
+               width);
+      }
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "chip8.h"
+
+/**
+ * Software scaler: expands the display straight into a 32-bit output
+ * buffer (a locked texture or a window surface) at an integer scale.
+ *
+ * Each display row is packed into a 64-bit mask, which makes change
+ * detection a word compare and lets the Scale2x (EPX) rules run on a whole
+ * row at once with bitwise operations. Output lines are built with SSE2 or
+ * NEON span fills and copied down the rest of the cell, and only the band
+ * of rows that changed since the last update is rewritten.
+ *
+ * The palette maps 256 grey levels to pixel values in the format of the
+ * destination; level 0 is an unlit pixel and 255 a lit one.
+ */
+#define SCALER_MAX_SCALE 32
+#define SCALER_LEVELS 256
+
+#define SCALER_SCANLINES 1
+#define SCALER_PHOSPHOR 2
+
+enum scaler_filter_t {
+  SCALER_NEAREST,
+  SCALER_SCALE2X,
+};
+
+struct scaler_t {
+  int scale;
+  int filter;
+  int effects;
+  int valid;
+  uint32_t palette[SCALER_LEVELS];
+  uint32_t dim[SCALER_LEVELS];
+  uint64_t rows[CHIP8_DISPLAY_HEIGHT];
+  // rows that still have pixels fading out, bit y = row y
+  uint32_t fading;
+  uint8_t fade[CHIP8_DISPLAY_HEIGHT][CHIP8_DISPLAY_WIDTH];
+  uint32_t line[CHIP8_DISPLAY_WIDTH * SCALER_MAX_SCALE];
+  uint32_t dim_line[CHIP8_DISPLAY_WIDTH * SCALER_MAX_SCALE];
+};
+
+int scaler_init(struct scaler_t* scaler, int scale, int filter, int effects,
+                const uint32_t palette[SCALER_LEVELS]);
+
+void scaler_invalidate(struct scaler_t* scaler);
+
+int scaler_update(struct scaler_t* scaler, const struct chip8_t* chip8,
+                  int* first);
+
+void scaler_render(struct scaler_t* scaler, int first, int count,
+                   uint32_t* pixels, int pitch);
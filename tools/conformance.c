@@ -0,0 +1,377 @@
+/**
+ * Golden-frame conformance suite: runs every ROM under roms/ headlessly with
+ * a scripted input sequence and compares the display and machine state hash
+ * at a few checkpoint frames against tools/conformance.golden. ROMs are
+ * spread over one thread per core.
+ *
+ * Usage: chip8-conformance [options]
+ *   --roms <dir>      directory searched recursively for *.ch8 (default: roms)
+ *   --golden <file>   golden hash file (default: tools/conformance.golden)
+ *   --script <file>   input script instead of the built-in one
+ *   --out <dir>       where mismatching frames are dumped as PBM images
+ *                     (default: conformance-out)
+ *   --bless           rewrite the golden file from the current results
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "chip8.h"
+#include "headless.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#endif
+
+#define CONFORMANCE_CHECKPOINTS 3
+#define CONFORMANCE_MAX_THREADS 64
+
+static const unsigned long CHECKPOINT_FRAMES[CONFORMANCE_CHECKPOINTS] = {
+  60, 600, 1800
+};
+
+struct golden_t {
+  char* rom;
+  unsigned long frame;
+  uint64_t display;
+  uint64_t state;
+};
+
+struct rom_result_t {
+  char* rom;
+  int loaded;
+  uint64_t display[CONFORMANCE_CHECKPOINTS];
+  uint64_t state[CONFORMANCE_CHECKPOINTS];
+  int mismatches;
+};
+
+struct suite_t {
+  struct rom_result_t* roms;
+  size_t rom_count;
+  struct golden_t* golden;
+  size_t golden_count;
+  const struct input_script_t* script;
+  const char* out_dir;
+  int bless;
+  atomic_size_t next;
+};
+
+static char* string_dup(const char* s) {
+  size_t len = strlen(s) + 1;
+  char* copy = malloc(len);
+  if(copy) {
+    memcpy(copy, s, len);
+  }
+  return copy;
+}
+
+static int has_suffix(const char* s, const char* suffix) {
+  size_t len = strlen(s), suffix_len = strlen(suffix);
+  return len >= suffix_len && strcmp(s + len - suffix_len, suffix) == 0;
+}
+
+static int rom_push(struct suite_t* suite, const char* path) {
+  struct rom_result_t* roms =
+    realloc(suite->roms, (suite->rom_count + 1) * sizeof(*roms));
+  if(!roms) {
+    return 0;
+  }
+  suite->roms = roms;
+  memset(&roms[suite->rom_count], 0, sizeof(*roms));
+  roms[suite->rom_count].rom = string_dup(path);
+  return roms[suite->rom_count++].rom != NULL;
+}
+
+static int rom_scan(struct suite_t* suite, const char* dir) {
+  DIR* dp = opendir(dir);
+  if(!dp) {
+    fprintf(stderr, "can't open directory: '%s'\n", dir);
+    return 0;
+  }
+  struct dirent* entry;
+  int ok = 1;
+  while(ok && (entry = readdir(dp))) {
+    if(entry->d_name[0] == '.') {
+      continue;
+    }
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+    struct stat st;
+    if(stat(path, &st) != 0) {
+      continue;
+    }
+    if(S_ISDIR(st.st_mode)) {
+      ok = rom_scan(suite, path);
+    } else if(has_suffix(entry->d_name, ".ch8")) {
+      ok = rom_push(suite, path);
+    }
+  }
+  closedir(dp);
+  return ok;
+}
+
+static int rom_compare(const void* a, const void* b) {
+  return strcmp(((const struct rom_result_t*)a)->rom,
+                ((const struct rom_result_t*)b)->rom);
+}
+
+/**
+ * Golden lines are "<frame> <display hash> <state hash> <rom path>"; the
+ * path comes last because ROM names contain spaces.
+ */
+static int golden_load(struct suite_t* suite, const char* filename) {
+  FILE* fp = fopen(filename, "r");
+  if(!fp) {
+    fprintf(stderr, "can't open file: '%s' (run with --bless to create it)\n",
+            filename);
+    return 0;
+  }
+  char line[1024];
+  while(fgets(line, sizeof(line), fp)) {
+    unsigned long frame;
+    unsigned long long display, state;
+    int offset;
+    if(line[0] == '#' ||
+       sscanf(line, "%lu %llx %llx %n", &frame, &display, &state, &offset) !=
+         3) {
+      continue;
+    }
+    line[strcspn(line, "\r\n")] = '\0';
+    struct golden_t* golden =
+      realloc(suite->golden, (suite->golden_count + 1) * sizeof(*golden));
+    if(!golden) {
+      fclose(fp);
+      return 0;
+    }
+    suite->golden = golden;
+    golden[suite->golden_count].rom = string_dup(line + offset);
+    golden[suite->golden_count].frame = frame;
+    golden[suite->golden_count].display = display;
+    golden[suite->golden_count].state = state;
+    suite->golden_count++;
+  }
+  fclose(fp);
+  return 1;
+}
+
+static const struct golden_t* golden_find(const struct suite_t* suite,
+                                          const char* rom,
+                                          unsigned long frame) {
+  for(size_t i = 0; i < suite->golden_count; i++) {
+    if(suite->golden[i].frame == frame &&
+       strcmp(suite->golden[i].rom, rom) == 0) {
+      return &suite->golden[i];
+    }
+  }
+  return NULL;
+}
+
+static int golden_save(const struct suite_t* suite, const char* filename) {
+  FILE* fp = fopen(filename, "w");
+  if(!fp) {
+    fprintf(stderr, "can't open file: '%s'\n", filename);
+    return 0;
+  }
+  fprintf(fp, "# <frame> <display hash> <state hash> <rom>\n");
+  fprintf(fp, "# generated by chip8-conformance --bless\n");
+  for(size_t i = 0; i < suite->rom_count; i++) {
+    const struct rom_result_t* result = &suite->roms[i];
+    if(!result->loaded) {
+      continue;
+    }
+    for(int j = 0; j < CONFORMANCE_CHECKPOINTS; j++) {
+      fprintf(fp, "%lu %.16llX %.16llX %s\n", CHECKPOINT_FRAMES[j],
+              (unsigned long long)result->display[j],
+              (unsigned long long)result->state[j], result->rom);
+    }
+  }
+  fclose(fp);
+  return 1;
+}
+
+static void frame_dump(const struct suite_t* suite, const char* rom,
+                       unsigned long frame, const struct chip8_t* chip8) {
+  // created on the first mismatch, so passing runs leave nothing behind
+  mkdir(suite->out_dir, 0755);
+  char path[1024];
+  int len = snprintf(path, sizeof(path), "%s/", suite->out_dir);
+  for(const char* p = rom; *p && len < (int)sizeof(path) - 32; p++) {
+    char c = *p;
+    int plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                (c >= '0' && c <= '9') || c == '-' || c == '.';
+    path[len++] = plain ? c : '_';
+  }
+  snprintf(path + len, sizeof(path) - len, "-%lu.pbm", frame);
+
+  FILE* fp = fopen(path, "w");
+  if(!fp) {
+    fprintf(stderr, "can't open file: '%s'\n", path);
+    return;
+  }
+  fprintf(fp, "P1\n%d %d\n", CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT);
+  for(int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
+    for(int x = 0; x < CHIP8_DISPLAY_WIDTH; x++) {
+      fputc(chip8->gfx[y][x] == CHIP8_DISPLAY_WHITE ? '1' : '0', fp);
+    }
+    fputc('\n', fp);
+  }
+  fclose(fp);
+  printf("  wrote %s\n", path);
+}
+
+static void rom_run(struct suite_t* suite, struct rom_result_t* result) {
+  struct chip8_t chip8;
+  chip8_init(&chip8);
+  if(!chip8_load_program(&chip8, result->rom)) {
+    // chip8_load_program() leaves its own message unterminated
+    fprintf(stderr, "\ncan't load rom: '%s'\n", result->rom);
+    return;
+  }
+  result->loaded = 1;
+
+  unsigned long frame = 0;
+  for(int i = 0; i < CONFORMANCE_CHECKPOINTS; i++) {
+    for(; frame < CHECKPOINT_FRAMES[i]; frame++) {
+      headless_frame(&chip8, chip8_cricle, suite->script, frame);
+    }
+    result->display[i] = chip8_hash_display(&chip8);
+    result->state[i] = chip8_hash(&chip8);
+    if(suite->bless) {
+      continue;
+    }
+
+    const struct golden_t* golden = golden_find(suite, result->rom, frame);
+    if(!golden) {
+      printf("MISSING %s @%lu\n", result->rom, frame);
+      result->mismatches++;
+    } else if(golden->display != result->display[i] ||
+              golden->state != result->state[i]) {
+      printf("FAIL %s @%lu: %s (display %.16llX, expected %.16llX)\n",
+             result->rom, frame,
+             golden->display != result->display[i] ? "display differs"
+                                                   : "state differs",
+             (unsigned long long)result->display[i],
+             (unsigned long long)golden->display);
+      frame_dump(suite, result->rom, frame, &chip8);
+      result->mismatches++;
+    }
+  }
+}
+
+static void* suite_worker(void* arg) {
+  struct suite_t* suite = (struct suite_t*)arg;
+  for(;;) {
+    size_t i = atomic_fetch_add(&suite->next, 1);
+    if(i >= suite->rom_count) {
+      return NULL;
+    }
+    rom_run(suite, &suite->roms[i]);
+  }
+}
+
+static void input_script_builtin(struct input_script_t* script) {
+  // walk the usual movement/fire keys: hold each for 8 frames, every 24
+  static const uint8_t KEYS[] = {0x5, 0x4, 0x6, 0x8, 0x2, 0x1,
+                                 0xC, 0xA, 0x0, 0xB, 0xF, 0x7};
+  const size_t count = 2 * 2000 / 24;
+  script->events = malloc(count * sizeof(*script->events));
+  script->count = 0;
+  if(!script->events) {
+    return;
+  }
+  for(unsigned long frame = 30; script->count + 2 <= count; frame += 24) {
+    uint8_t key = KEYS[(frame / 24) % (sizeof(KEYS) / sizeof(KEYS[0]))];
+    script->events[script->count++] = (struct input_event_t){frame, key, 1};
+    script->events[script->count++] =
+      (struct input_event_t){frame + 8, key, 0};
+  }
+}
+
+int main(int argc, char const* argv[]) {
+  const char* roms_dir = "roms";
+  const char* golden_file = "tools/conformance.golden";
+  const char* script_file = NULL;
+  struct suite_t suite;
+  memset(&suite, 0, sizeof(suite));
+  suite.out_dir = "conformance-out";
+
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--roms") == 0 && i + 1 < argc) {
+      roms_dir = argv[++i];
+    } else if(strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+      golden_file = argv[++i];
+    } else if(strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+      script_file = argv[++i];
+    } else if(strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      suite.out_dir = argv[++i];
+    } else if(strcmp(argv[i], "--bless") == 0) {
+      suite.bless = 1;
+    } else {
+      printf(
+        "Usage: chip8-conformance [--roms <dir>] [--golden <file>] "
+        "[--script <file>] [--out <dir>] [--bless]\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  struct input_script_t script;
+  if(script_file) {
+    if(!input_script_load(&script, script_file)) {
+      return EXIT_FAILURE;
+    }
+  } else {
+    input_script_builtin(&script);
+  }
+  suite.script = &script;
+
+  if(!rom_scan(&suite, roms_dir) ||
+     (!suite.bless && !golden_load(&suite, golden_file))) {
+    return EXIT_FAILURE;
+  }
+  qsort(suite.roms, suite.rom_count, sizeof(*suite.roms), rom_compare);
+
+  int threads = headless_cpu_count(CONFORMANCE_MAX_THREADS);
+  pthread_t workers[CONFORMANCE_MAX_THREADS];
+  atomic_init(&suite.next, 0);
+  for(int i = 0; i < threads; i++) {
+    pthread_create(&workers[i], NULL, suite_worker, &suite);
+  }
+  for(int i = 0; i < threads; i++) {
+    pthread_join(workers[i], NULL);
+  }
+
+  int status = EXIT_SUCCESS;
+  if(suite.bless) {
+    if(!golden_save(&suite, golden_file)) {
+      status = EXIT_FAILURE;
+    } else {
+      printf("blessed %zu roms into %s\n", suite.rom_count, golden_file);
+    }
+  } else {
+    size_t failed = 0;
+    for(size_t i = 0; i < suite.rom_count; i++) {
+      failed += !suite.roms[i].loaded || suite.roms[i].mismatches != 0;
+    }
+    printf("%zu/%zu roms match %s\n", suite.rom_count - failed,
+           suite.rom_count, golden_file);
+    status = failed ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  for(size_t i = 0; i < suite.rom_count; i++) {
+    free(suite.roms[i].rom);
+  }
+  for(size_t i = 0; i < suite.golden_count; i++) {
+    free(suite.golden[i].rom);
+  }
+  free(suite.roms);
+  free(suite.golden);
+  input_script_free(&script);
+  return status;
+}
@@ -0,0 +1,315 @@
+#include "explore.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct explore_memory_t {
+  atomic_int refs;
+  uint8_t bytes[CHIP8_MEMORY_SIZE];
+};
+
+static struct explore_memory_t* memory_create(const uint8_t* bytes) {
+  struct explore_memory_t* memory = malloc(sizeof(*memory));
+  if(!memory) {
+    return NULL;
+  }
+  atomic_init(&memory->refs, 1);
+  memcpy(memory->bytes, bytes, CHIP8_MEMORY_SIZE);
+  return memory;
+}
+
+static void memory_release(struct explore_memory_t* memory) {
+  if(memory && atomic_fetch_sub(&memory->refs, 1) == 1) {
+    free(memory);
+  }
+}
+
+static void state_save(struct explore_state_t* state,
+                       const struct chip8_t* chip8) {
+  memcpy(state->V, chip8->V, sizeof(state->V));
+  state->I = chip8->I;
+  state->pc = chip8->pc;
+  memcpy(state->stack, chip8->stack, sizeof(state->stack));
+  state->sp = chip8->sp;
+  state->rng = chip8->rng;
+  state->cycles = chip8->cycles;
+  state->delay_deadline = chip8->delay_deadline;
+  state->sound_deadline = chip8->sound_deadline;
+  state->keys = 0;
+  for(int i = 0; i < CHIP8_KEY_SIZE; i++) {
+    state->keys |= (chip8->keystate[i] ? 1 : 0) << i;
+  }
+  for(int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
+    for(int x = 0; x < CHIP8_DISPLAY_WIDTH; x += 8) {
+      uint8_t bits = 0;
+      for(int b = 0; b < 8; b++) {
+        bits |= (chip8->gfx[y][x + b] == CHIP8_DISPLAY_WHITE) << (7 - b);
+      }
+      state->display[y][x / 8] = bits;
+    }
+  }
+}
+
+int explore_capture(struct explore_state_t* state,
+                    const struct chip8_t* chip8) {
+  memset(state, 0, sizeof(*state));
+  state->memory = memory_create(chip8->memory);
+  if(!state->memory) {
+    return 0;
+  }
+  state_save(state, chip8);
+  return 1;
+}
+
+void explore_restore(const struct explore_state_t* state,
+                     struct chip8_t* chip8) {
+  memset(chip8, 0, sizeof(*chip8));
+  chip8->state = CHIP8_STATE_PLAYING;
+  memcpy(chip8->V, state->V, sizeof(chip8->V));
+  chip8->I = state->I;
+  chip8->pc = state->pc;
+  chip8->cycles = state->cycles;
+  chip8->delay_deadline = state->delay_deadline;
+  chip8->sound_deadline = state->sound_deadline;
+  memcpy(chip8->memory, state->memory->bytes, CHIP8_MEMORY_SIZE);
+  memcpy(chip8->stack, state->stack, sizeof(chip8->stack));
+  chip8->sp = state->sp;
+  for(int i = 0; i < CHIP8_KEY_SIZE; i++) {
+    chip8->keystate[i] = (state->keys >> i) & 1;
+  }
+  for(int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
+    for(int x = 0; x < CHIP8_DISPLAY_WIDTH; x++) {
+      chip8->gfx[y][x] = (state->display[y][x / 8] & (0x80 >> (x % 8)))
+                           ? CHIP8_DISPLAY_WHITE
+                           : CHIP8_DISPLAY_BLACK;
+    }
+  }
+  chip8->draw_flag = 1;
+  chip8->rng = state->rng;
+}
+
+void explore_fork(const struct explore_state_t* parent,
+                  struct explore_state_t* children, size_t count) {
+  for(size_t i = 0; i < count; i++) {
+    children[i] = *parent;
+    children[i].score = 0;
+  }
+  atomic_fetch_add(&parent->memory->refs, (int)count);
+}
+
+void explore_release(struct explore_state_t* state) {
+  memory_release(state->memory);
+  state->memory = NULL;
+}
+
+/**
+ * Each worker owns a range of child indices. The owner pops from the
+ * front; a worker that runs dry steals the back half of another range.
+ */
+struct explore_deque_t {
+  pthread_mutex_t lock;
+  size_t lo, hi;
+};
+
+struct explore_worker_t {
+  struct explore_pool_t* pool;
+  int index;
+  pthread_t thread;
+};
+
+struct explore_pool_t {
+  int threads;
+  struct explore_worker_t* workers;
+  struct explore_deque_t* deques;
+  pthread_mutex_t lock;
+  pthread_cond_t wake, done;
+  unsigned long generation;
+  int pending;
+  int quit;
+  atomic_int failed;
+
+  struct explore_state_t* children;
+  unsigned long frames;
+  const struct explore_ops_t* ops;
+};
+
+static int deque_pop(struct explore_deque_t* deque, size_t* index) {
+  int ok = 0;
+  pthread_mutex_lock(&deque->lock);
+  if(deque->lo < deque->hi) {
+    *index = deque->lo++;
+    ok = 1;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return ok;
+}
+
+static int deque_steal(struct explore_pool_t* pool, int thief) {
+  for(int i = 1; i < pool->threads; i++) {
+    struct explore_deque_t* victim =
+      &pool->deques[(thief + i) % pool->threads];
+    size_t lo = 0, hi = 0;
+    pthread_mutex_lock(&victim->lock);
+    if(victim->lo < victim->hi) {
+      hi = victim->hi;
+      lo = victim->hi - (victim->hi - victim->lo + 1) / 2;
+      victim->hi = lo;
+    }
+    pthread_mutex_unlock(&victim->lock);
+    if(lo < hi) {
+      struct explore_deque_t* own = &pool->deques[thief];
+      pthread_mutex_lock(&own->lock);
+      own->lo = lo;
+      own->hi = hi;
+      pthread_mutex_unlock(&own->lock);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void child_run(struct explore_pool_t* pool, size_t index,
+                      struct chip8_t* chip8) {
+  struct explore_state_t* child = &pool->children[index];
+  const struct explore_ops_t* ops = pool->ops;
+  explore_restore(child, chip8);
+  for(unsigned long frame = 0; frame < pool->frames; frame++) {
+    if(ops && ops->input) {
+      uint16_t keys = ops->input(index, frame, ops->user);
+      for(int i = 0; i < CHIP8_KEY_SIZE; i++) {
+        chip8->keystate[i] = (keys >> i) & 1;
+      }
+    }
+    for(int i = 0; i < CHIP8_CYCLES_PER_FRAME; i++) {
+      chip8_cricle(chip8);
+    }
+  }
+
+  // copy-on-write: only a child that changed memory gets its own image
+  if(memcmp(chip8->memory, child->memory->bytes, CHIP8_MEMORY_SIZE) != 0) {
+    struct explore_memory_t* memory = memory_create(chip8->memory);
+    if(!memory) {
+      atomic_store(&pool->failed, 1);
+      return;
+    }
+    memory_release(child->memory);
+    child->memory = memory;
+  }
+  state_save(child, chip8);
+  child->score = ops && ops->score ? ops->score(chip8, index, ops->user) : 0;
+}
+
+static void* explore_worker(void* arg) {
+  struct explore_worker_t* worker = (struct explore_worker_t*)arg;
+  struct explore_pool_t* pool = worker->pool;
+  struct chip8_t* chip8 = malloc(sizeof(*chip8));
+  unsigned long seen = 0;
+
+  for(;;) {
+    pthread_mutex_lock(&pool->lock);
+    while(!pool->quit && pool->generation == seen) {
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    }
+    seen = pool->generation;
+    int quit = pool->quit;
+    pthread_mutex_unlock(&pool->lock);
+    if(quit) {
+      break;
+    }
+
+    size_t index;
+    if(!chip8) {
+      atomic_store(&pool->failed, 1);
+    } else {
+      do {
+        while(deque_pop(&pool->deques[worker->index], &index)) {
+          child_run(pool, index, chip8);
+        }
+      } while(deque_steal(pool, worker->index));
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    if(--pool->pending == 0) {
+      pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+  free(chip8);
+  return NULL;
+}
+
+struct explore_pool_t* explore_pool_create(int threads) {
+  struct explore_pool_t* pool = calloc(1, sizeof(*pool));
+  if(!pool) {
+    return NULL;
+  }
+  pool->threads = threads < 1 ? 1 : threads;
+  pool->workers = calloc(pool->threads, sizeof(*pool->workers));
+  pool->deques = calloc(pool->threads, sizeof(*pool->deques));
+  if(!pool->workers || !pool->deques) {
+    free(pool->workers);
+    free(pool->deques);
+    free(pool);
+    return NULL;
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  atomic_init(&pool->failed, 0);
+  for(int i = 0; i < pool->threads; i++) {
+    pthread_mutex_init(&pool->deques[i].lock, NULL);
+    pool->workers[i].pool = pool;
+    pool->workers[i].index = i;
+    pthread_create(&pool->workers[i].thread, NULL, explore_worker,
+                   &pool->workers[i]);
+  }
+  return pool;
+}
+
+void explore_pool_destroy(struct explore_pool_t* pool) {
+  if(!pool) {
+    return;
+  }
+  pthread_mutex_lock(&pool->lock);
+  pool->quit = 1;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+  for(int i = 0; i < pool->threads; i++) {
+    pthread_join(pool->workers[i].thread, NULL);
+    pthread_mutex_destroy(&pool->deques[i].lock);
+  }
+  pthread_cond_destroy(&pool->done);
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->deques);
+  free(pool->workers);
+  free(pool);
+}
+
+/**
+ * Runs every child for 'frames' frames and blocks until all are done.
+ * Children are updated in place; returns 0 if a worker ran out of memory.
+ */
+int explore_run(struct explore_pool_t* pool, struct explore_state_t* children,
+                size_t count, unsigned long frames,
+                const struct explore_ops_t* ops) {
+  pthread_mutex_lock(&pool->lock);
+  pool->children = children;
+  pool->frames = frames;
+  pool->ops = ops;
+  atomic_store(&pool->failed, 0);
+  for(int i = 0; i < pool->threads; i++) {
+    pool->deques[i].lo = count * i / pool->threads;
+    pool->deques[i].hi = count * (i + 1) / pool->threads;
+  }
+  pool->pending = pool->threads;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->wake);
+  while(pool->pending > 0) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return !atomic_load(&pool->failed);
+}
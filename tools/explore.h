@@ -0,0 +1,61 @@
+#pragma once
+
+#include "chip8.h"
+
+#include <stddef.h>
+
+/**
+ * Fork-and-explore: branch one machine into many children that share its
+ * memory copy-on-write and run them for a number of frames with their own
+ * key inputs on a work-stealing thread pool.
+ *
+ * A state carries only the registers, a 1-bit packed display and a
+ * reference to a shared memory image, so forking is a ~360 byte copy plus
+ * a reference count increment. Children are expanded into a full
+ * struct chip8_t on the worker that runs them; a child gets a private
+ * memory image only if the run actually wrote to memory.
+ */
+struct explore_memory_t;
+
+struct explore_state_t {
+  struct explore_memory_t* memory;
+  uint8_t V[CHIP8_REGISTER_SIZE];
+  uint16_t I;
+  uint16_t pc;
+  uint16_t stack[CHIP8_STACK_SIZE];
+  uint8_t sp;
+  uint16_t keys;
+  uint32_t rng;
+  uint64_t cycles;
+  uint64_t delay_deadline, sound_deadline;
+  uint8_t display[CHIP8_DISPLAY_HEIGHT][CHIP8_DISPLAY_WIDTH / 8];
+  int64_t score;
+};
+
+struct explore_ops_t {
+  // keys held by 'child' during 'frame' (bit i = key i), may be NULL
+  uint16_t (*input)(size_t child, unsigned long frame, void* user);
+  // scores the child's machine after its run, may be NULL
+  int64_t (*score)(const struct chip8_t* chip8, size_t child, void* user);
+  void* user;
+};
+
+struct explore_pool_t;
+
+int explore_capture(struct explore_state_t* state, const struct chip8_t* chip8);
+
+void explore_restore(const struct explore_state_t* state,
+                     struct chip8_t* chip8);
+
+void explore_fork(const struct explore_state_t* parent,
+                  struct explore_state_t* children, size_t count);
+
+void explore_release(struct explore_state_t* state);
+
+struct explore_pool_t* explore_pool_create(int threads);
+
+void explore_pool_destroy(struct explore_pool_t* pool);
+
+int explore_run(struct explore_pool_t* pool, struct explore_state_t* children,
+                size_t count, unsigned long frames,
+                const struct explore_ops_t* ops);
@@ -0,0 +1,136 @@
+/**
+ * Greedy explorer built on explore.h: from the current best state, fork one
+ * child per keypad key (plus one with no key held), run them all for a few
+ * frames, keep the child with the most lit pixels and repeat. Prints the
+ * branch throughput, which is mostly a benchmark of fork + run.
+ *
+ * Usage: chip8-explore [options] <rom file>
+ *   --warmup <n>     frames to run before the first fork (default: 120)
+ *   --children <k>   children per round (default: 4096)
+ *   --frames <n>     frames each child runs (default: 10)
+ *   --rounds <r>     rounds to run (default: 8)
+ */
+#include "chip8.h"
+#include "explore.h"
+#include "headless.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define EXPLORE_MAX_THREADS 64
+
+static double seconds_now() {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint16_t input_one_key(size_t child, unsigned long frame, void* user) {
+  size_t key = child % (CHIP8_KEY_SIZE + 1);
+  return key < CHIP8_KEY_SIZE ? (uint16_t)(1 << key) : 0;
+}
+
+static int64_t score_lit_pixels(const struct chip8_t* chip8, size_t child,
+                                void* user) {
+  int64_t lit = 0;
+  for(int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
+    for(int x = 0; x < CHIP8_DISPLAY_WIDTH; x++) {
+      lit += chip8->gfx[y][x] == CHIP8_DISPLAY_WHITE;
+    }
+  }
+  return lit;
+}
+
+int main(int argc, char const* argv[]) {
+  const char* rom = NULL;
+  unsigned long warmup = 120, frames = 10, rounds = 8;
+  size_t count = 4096;
+
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+      warmup = strtoul(argv[++i], NULL, 0);
+    } else if(strcmp(argv[i], "--children") == 0 && i + 1 < argc) {
+      count = strtoul(argv[++i], NULL, 0);
+    } else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frames = strtoul(argv[++i], NULL, 0);
+    } else if(strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+      rounds = strtoul(argv[++i], NULL, 0);
+    } else if(argv[i][0] != '-' && !rom) {
+      rom = argv[i];
+    } else {
+      rom = NULL;
+      break;
+    }
+  }
+  if(!rom || count == 0) {
+    printf(
+      "Usage: chip8-explore [--warmup <n>] [--children <k>] [--frames <n>] "
+      "[--rounds <r>] <rom file>\n");
+    return EXIT_FAILURE;
+  }
+
+  static struct chip8_t chip8;
+  chip8_init(&chip8);
+  if(!chip8_load_program(&chip8, rom)) {
+    return EXIT_FAILURE;
+  }
+  for(unsigned long frame = 0; frame < warmup; frame++) {
+    headless_frame(&chip8, chip8_cricle, NULL, frame);
+  }
+
+  struct explore_state_t best;
+  struct explore_state_t* children = malloc(count * sizeof(*children));
+  struct explore_pool_t* pool =
+    explore_pool_create(headless_cpu_count(EXPLORE_MAX_THREADS));
+  if(!children || !pool || !explore_capture(&best, &chip8)) {
+    fprintf(stderr, "out of memory\n");
+    return EXIT_FAILURE;
+  }
+
+  const struct explore_ops_t ops = {input_one_key, score_lit_pixels, NULL};
+  double fork_time = 0, run_time = 0;
+  int status = EXIT_SUCCESS;
+  for(unsigned long round = 0; round < rounds; round++) {
+    double start = seconds_now();
+    explore_fork(&best, children, count);
+    double forked = seconds_now();
+    if(!explore_run(pool, children, count, frames, &ops)) {
+      fprintf(stderr, "out of memory\n");
+      status = EXIT_FAILURE;
+    }
+    double done = seconds_now();
+    fork_time += forked - start;
+    run_time += done - forked;
+
+    size_t winner = 0;
+    for(size_t i = 1; i < count; i++) {
+      if(children[i].score > children[winner].score) {
+        winner = i;
+      }
+    }
+    printf("round %lu: best child %zu (key %zX) scored %lld\n", round, winner,
+           winner % (CHIP8_KEY_SIZE + 1), (long long)children[winner].score);
+
+    explore_release(&best);
+    best = children[winner];
+    children[winner].memory = NULL;
+    for(size_t i = 0; i < count; i++) {
+      explore_release(&children[i]);
+    }
+    if(status != EXIT_SUCCESS) {
+      break;
+    }
+  }
+
+  double branches = (double)count * rounds;
+  printf("%.0f branches of %lu frames: fork %.3f us/branch, %.0f branches/s\n",
+         branches, frames, fork_time * 1e6 / branches,
+         branches / (fork_time + run_time));
+
+  explore_release(&best);
+  explore_pool_destroy(pool);
+  free(children);
+  return status;
+}
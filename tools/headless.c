@@ -0,0 +1,103 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "headless.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int input_script_push(struct input_script_t* script,
+                             struct input_event_t event) {
+  struct input_event_t* events =
+    realloc(script->events, (script->count + 1) * sizeof(*events));
+  if(!events) {
+    return 0;
+  }
+  script->events = events;
+  script->events[script->count++] = event;
+  return 1;
+}
+
+int input_script_load(struct input_script_t* script, const char* filename) {
+  memset(script, 0, sizeof(*script));
+  FILE* fp = fopen(filename, "r");
+  if(!fp) {
+    fprintf(stderr, "can't open file: '%s'\n", filename);
+    return 0;
+  }
+  char line[256];
+  int lineno = 0;
+  while(fgets(line, sizeof(line), fp)) {
+    lineno++;
+    unsigned long frame;
+    unsigned int key;
+    char action[8];
+    if(line[0] == '#' || strspn(line, " \t\r\n") == strlen(line)) {
+      continue;
+    }
+    if(sscanf(line, "%lu %x %7s", &frame, &key, action) != 3 ||
+       key >= CHIP8_KEY_SIZE ||
+       (strcmp(action, "down") != 0 && strcmp(action, "up") != 0)) {
+      fprintf(stderr, "%s:%d: expected '<frame> <key> <down|up>'\n", filename,
+              lineno);
+      fclose(fp);
+      input_script_free(script);
+      return 0;
+    }
+    struct input_event_t event = {frame, (uint8_t)key,
+                                  strcmp(action, "down") == 0};
+    if(!input_script_push(script, event)) {
+      fprintf(stderr, "out of memory\n");
+      fclose(fp);
+      input_script_free(script);
+      return 0;
+    }
+  }
+  fclose(fp);
+  return 1;
+}
+
+void input_script_free(struct input_script_t* script) {
+  free(script->events);
+  script->events = NULL;
+  script->count = 0;
+}
+
+void input_script_apply(const struct input_script_t* script,
+                        unsigned long frame, struct chip8_t* chip8) {
+  if(!script) {
+    return;
+  }
+  for(size_t i = 0; i < script->count; i++) {
+    if(script->events[i].frame == frame) {
+      chip8->keystate[script->events[i].key] = script->events[i].down;
+    }
+  }
+}
+
+int headless_cpu_count(int max) {
+#if defined(_WIN32)
+  const char* cores = getenv("NUMBER_OF_PROCESSORS");
+  int count = cores ? atoi(cores) : 1;
+#else
+  int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if(count < 1) {
+    return 1;
+  }
+  return count > max ? max : count;
+}
+
+/**
+ * Runs one 60Hz frame the way main() paces it: input first, then
+ * CHIP8_CYCLES_PER_FRAME instructions. The timers follow the instruction
+ * clock, so there is nothing else to tick.
+ */
+void headless_frame(struct chip8_t* chip8, chip8_engine_t engine,
+                    const struct input_script_t* script, unsigned long frame) {
+  input_script_apply(script, frame, chip8);
+  for(int i = 0; i < CHIP8_CYCLES_PER_FRAME; i++) {
+    engine(chip8);
+  }
+}
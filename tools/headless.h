@@ -0,0 +1,33 @@
+#pragma once
+
+#include "chip8.h"
+
+#include <stddef.h>
+
+/**
+ * A scripted input sequence for running a ROM without a window. Each line
+ * of a script file is "<frame> <key> <down|up>", where key is the keypad
+ * digit 0-F; blank lines and lines starting with '#' are ignored.
+ */
+struct input_event_t {
+  unsigned long frame;
+  uint8_t key;
+  uint8_t down;
+};
+
+struct input_script_t {
+  struct input_event_t* events;
+  size_t count;
+};
+
+int input_script_load(struct input_script_t* script, const char* filename);
+
+void input_script_free(struct input_script_t* script);
+
+void input_script_apply(const struct input_script_t* script,
+                        unsigned long frame, struct chip8_t* chip8);
+
+int headless_cpu_count(int max);
+
+void headless_frame(struct chip8_t* chip8, chip8_engine_t engine,
+                    const struct input_script_t* script, unsigned long frame);
@@ -0,0 +1,304 @@
+/**
+ * Differential lockstep harness: runs the reference switch interpreter and
+ * an alternative engine side by side on the same ROM and input script,
+ * comparing chip8_hash() of both machines after every frame (or every
+ * instruction with --every-instruction). On divergence the frame is bisected
+ * by replaying it from its starting snapshots for fewer cycles, down to the
+ * first instruction whose result differs, and both states are dumped.
+ *
+ * A compiled module only runs a block when the whole block fits in the
+ * budget, so with --aot the unit of comparison is the block: the module is
+ * stepped one block (or interpreted instruction) at a time with
+ * aot_step(), and a divergence is reported as the block that caused it.
+ *
+ * Usage: chip8-lockstep [options] <rom file>
+ *   --engine <name>        alternative engine (default: table)
+ *   --aot <module>         use a chip8-recompile module as the alternative
+ *   --frames <n>           frames to run (default: 3600)
+ *   --script <file>        input script, see headless.h
+ *   --every-instruction    compare after each instruction (each compiled
+ *                          block with --aot), not each frame
+ */
+#include "aot.h"
+#include "chip8.h"
+#include "headless.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct engine_entry_t {
+  const char* name;
+  chip8_engine_t engine;
+};
+
+static const struct engine_entry_t ENGINES[] = {
+  {"switch", chip8_cricle},
+  {"table", chip8_cricle_table},
+};
+
+static chip8_engine_t engine_find(const char* name) {
+  for(size_t i = 0; i < sizeof(ENGINES) / sizeof(ENGINES[0]); i++) {
+    if(strcmp(ENGINES[i].name, name) == 0) {
+      return ENGINES[i].engine;
+    }
+  }
+  return NULL;
+}
+
+static void lockstep_diff(const struct chip8_t* ref,
+                          const struct chip8_t* alt) {
+  printf("differs in:");
+  if(memcmp(ref->V, alt->V, sizeof(ref->V)) != 0) {
+    printf(" V");
+  }
+  if(ref->I != alt->I) {
+    printf(" I");
+  }
+  if(ref->pc != alt->pc) {
+    printf(" pc");
+  }
+  if(ref->sp != alt->sp ||
+     memcmp(ref->stack, alt->stack, sizeof(ref->stack)) != 0) {
+    printf(" stack");
+  }
+  if(ref->cycles != alt->cycles) {
+    printf(" cycles");
+  }
+  if(chip8_delay_timer(ref) != chip8_delay_timer(alt) ||
+     chip8_sound_timer(ref) != chip8_sound_timer(alt)) {
+    printf(" timers");
+  }
+  if(ref->rng != alt->rng) {
+    printf(" rng");
+  }
+  for(int i = 0; i < CHIP8_MEMORY_SIZE; i++) {
+    if(ref->memory[i] != alt->memory[i]) {
+      printf(" memory(first at 0x%.4X)", i);
+      break;
+    }
+  }
+  if(memcmp(ref->gfx, alt->gfx, sizeof(ref->gfx)) != 0) {
+    printf(" gfx");
+  }
+  printf("\n");
+}
+
+static void lockstep_report(struct chip8_t* ref, struct chip8_t* alt) {
+  lockstep_diff(ref, alt);
+  printf("\n==== reference ====");
+  chip8_dump_pc(ref, stdout);
+  chip8_dump_register(ref, stdout);
+  chip8_dump_memory(ref, stdout);
+  printf("\n==== alternative ====");
+  chip8_dump_pc(alt, stdout);
+  chip8_dump_register(alt, stdout);
+  chip8_dump_memory(alt, stdout);
+}
+
+// NULL when the alternative is the compiled module
+static chip8_engine_t alt_engine;
+// the module's state at the start of the current frame
+static struct aot_state_t aot_start;
+
+static void ref_run(struct chip8_t* chip8, uint64_t cycles) {
+  while(chip8->cycles < cycles) {
+    chip8_cricle(chip8);
+  }
+}
+
+static void alt_run(struct chip8_t* chip8, uint64_t cycles) {
+  if(!alt_engine) {
+    aot_run(chip8, cycles);
+    return;
+  }
+  while(chip8->cycles < cycles) {
+    alt_engine(chip8);
+  }
+}
+
+static void lockstep_replay(const struct chip8_t* ref_start,
+                            const struct chip8_t* alt_start,
+                            const struct input_script_t* script,
+                            unsigned long frame, int steps,
+                            struct chip8_t* ref, struct chip8_t* alt) {
+  *ref = *ref_start;
+  *alt = *alt_start;
+  if(!alt_engine) {
+    aot_restore(&aot_start);
+  }
+  input_script_apply(script, frame, ref);
+  input_script_apply(script, frame, alt);
+  ref_run(ref, ref_start->cycles + steps);
+  alt_run(alt, alt_start->cycles + steps);
+}
+
+/**
+ * Advances both machines by one unit of comparison: one instruction, or
+ * with a compiled module one block. Returns the length of the compiled
+ * block that ran, 0 otherwise.
+ */
+static int lockstep_step(struct chip8_t* ref, struct chip8_t* alt,
+                         uint64_t end) {
+  int length = 0;
+  if(alt_engine) {
+    alt_run(alt, alt->cycles + 1);
+  } else {
+    length = aot_step(alt, end);
+  }
+  ref_run(ref, alt->cycles);
+  return length;
+}
+
+/**
+ * Bisects a diverging frame: replays it from its starting snapshots for
+ * fewer and fewer instructions until the first one that diverges is found.
+ */
+static void lockstep_bisect(const struct chip8_t* ref_start,
+                            const struct chip8_t* alt_start,
+                            const struct input_script_t* script,
+                            unsigned long frame) {
+  static struct chip8_t ref, alt;
+  int lo = 0, hi = CHIP8_CYCLES_PER_FRAME;
+  while(hi - lo > 1) {
+    int mid = lo + (hi - lo) / 2;
+    lockstep_replay(ref_start, alt_start, script, frame, mid, &ref, &alt);
+    if(chip8_hash(&ref) != chip8_hash(&alt)) {
+      hi = mid;
+    } else {
+      lo = mid;
+    }
+  }
+  lockstep_replay(ref_start, alt_start, script, frame, lo, &ref, &alt);
+  uint16_t pc = ref.pc;
+  lockstep_replay(ref_start, alt_start, script, frame, hi, &ref, &alt);
+  printf("divergence in frame %lu, instruction %d (pc 0x%.4X before)\n",
+         frame, lo, pc);
+  lockstep_report(&ref, &alt);
+}
+
+/**
+ * Bisecting by budget does not work for a compiled module: a shorter
+ * budget makes it interpret a block that ran compiled in the full frame.
+ * The frame is replayed block by block instead, up to the first block
+ * whose result differs.
+ */
+static void lockstep_bisect_blocks(const struct chip8_t* ref_start,
+                                   const struct chip8_t* alt_start,
+                                   const struct input_script_t* script,
+                                   unsigned long frame) {
+  static struct chip8_t ref, alt;
+  uint64_t end = alt_start->cycles + CHIP8_CYCLES_PER_FRAME;
+  lockstep_replay(ref_start, alt_start, script, frame, 0, &ref, &alt);
+  while(alt.cycles < end) {
+    uint16_t pc = alt.pc;
+    int length = lockstep_step(&ref, &alt, end);
+    if(chip8_hash(&ref) == chip8_hash(&alt)) {
+      continue;
+    }
+    if(length) {
+      printf(
+        "divergence in frame %lu, compiled block 0x%.4X-0x%.4X "
+        "(%d instructions)\n",
+        frame, pc, pc + 2 * length - 1, length);
+    } else {
+      printf("divergence in frame %lu, instruction at 0x%.4X\n", frame, pc);
+    }
+    lockstep_report(&ref, &alt);
+    return;
+  }
+  printf("divergence in frame %lu did not reproduce block by block\n",
+         frame);
+  lockstep_report(&ref, &alt);
+}
+
+int main(int argc, char const* argv[]) {
+  const char* rom = NULL;
+  const char* engine_name = "table";
+  const char* aot_file = NULL;
+  const char* script_file = NULL;
+  unsigned long frames = 3600;
+  int every_instruction = 0;
+
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+      engine_name = argv[++i];
+    } else if(strcmp(argv[i], "--aot") == 0 && i + 1 < argc) {
+      aot_file = argv[++i];
+      engine_name = "aot";
+    } else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frames = strtoul(argv[++i], NULL, 0);
+    } else if(strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+      script_file = argv[++i];
+    } else if(strcmp(argv[i], "--every-instruction") == 0) {
+      every_instruction = 1;
+    } else if(argv[i][0] != '-' && !rom) {
+      rom = argv[i];
+    } else {
+      rom = NULL;
+      break;
+    }
+  }
+  if(!rom) {
+    printf(
+      "Usage: chip8-lockstep [--engine <name> | --aot <module>] "
+      "[--frames <n>] [--script <file>] [--every-instruction] <rom file>\n");
+    return EXIT_FAILURE;
+  }
+
+  alt_engine = aot_file ? NULL : engine_find(engine_name);
+  if(!aot_file && !alt_engine) {
+    fprintf(stderr, "unknown engine: '%s'\n", engine_name);
+    return EXIT_FAILURE;
+  }
+
+  struct input_script_t script = {NULL, 0};
+  if(script_file && !input_script_load(&script, script_file)) {
+    return EXIT_FAILURE;
+  }
+
+  static struct chip8_t ref, alt, ref_start, alt_start;
+  chip8_init(&ref);
+  if(!chip8_load_program(&ref, rom) || (aot_file && !aot_load(aot_file, &ref))) {
+    input_script_free(&script);
+    return EXIT_FAILURE;
+  }
+  alt = ref;
+
+  int status = EXIT_SUCCESS;
+  for(unsigned long frame = 0; frame < frames; frame++) {
+    ref_start = ref;
+    alt_start = alt;
+    if(!alt_engine) {
+      aot_save(&aot_start);
+    }
+    input_script_apply(&script, frame, &ref);
+    input_script_apply(&script, frame, &alt);
+    uint64_t end = ref.cycles + CHIP8_CYCLES_PER_FRAME;
+    if(every_instruction) {
+      while(ref.cycles < end && chip8_hash(&ref) == chip8_hash(&alt)) {
+        lockstep_step(&ref, &alt, end);
+      }
+    } else {
+      ref_run(&ref, end);
+      alt_run(&alt, end);
+    }
+    if(chip8_hash(&ref) != chip8_hash(&alt)) {
+      if(alt_engine) {
+        lockstep_bisect(&ref_start, &alt_start, &script, frame);
+      } else {
+        lockstep_bisect_blocks(&ref_start, &alt_start, &script, frame);
+      }
+      status = EXIT_FAILURE;
+      break;
+    }
+  }
+
+  if(status == EXIT_SUCCESS) {
+    printf("%s: '%s' matches the reference for %lu frames (hash %.16llX)\n",
+           rom, engine_name, frames, (unsigned long long)chip8_hash(&ref));
+  }
+  aot_unload();
+  input_script_free(&script);
+  return status;
+}
@@ -0,0 +1,483 @@
+/**
+ * Static recompiler: disassembles a ROM, follows its control flow from
+ * 0x200 through jumps, calls, returns and skips, and writes a C file with
+ * one function per basic block plus a run() loop that switches on pc to
+ * chain them. Each instruction becomes a call to the op_* handler behind
+ * the interpreter's opcode_* (see chip8_ops.h) with its operands as
+ * constants, so the compiled ROM cannot drift from the interpreter's
+ * semantics.
+ *
+ * Anything the recompiler cannot see statically is left to the
+ * interpreter at run time: BNNN targets, code outside the ROM, and every
+ * block the ROM writes over (see aot.c).
+ *
+ * Usage: chip8-recompile <rom file> <output .c file>
+ * Build: gcc -O2 -shared -fPIC -I <repo> <output .c file> -o <module>
+ * Run:   chip8-emulator <rom file> <module>
+ */
+#include "chip8.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// keeps blocks short enough that a frame's budget rarely ends with a
+// block that does not fit and has to be interpreted
+#define RECOMPILE_MAX_BLOCK 16
+
+struct recompiler_t {
+  uint8_t memory[CHIP8_MEMORY_SIZE];
+  uint16_t rom_end;
+  uint8_t reachable[CHIP8_MEMORY_SIZE];
+  uint8_t leader[CHIP8_MEMORY_SIZE];
+  uint8_t lengths[CHIP8_MEMORY_SIZE];
+  uint8_t code_map[CHIP8_MEMORY_SIZE / 8];
+};
+
+static uint16_t fetch(const struct recompiler_t* rc, uint16_t addr) {
+  return (uint16_t)(rc->memory[addr] << 8 | rc->memory[addr + 1]);
+}
+
+static int is_skip(uint16_t op) {
+  switch(op >> 12) {
+    case 0x3:
+    case 0x4:
+    case 0x5:
+    case 0x9:
+      return 1;
+    case 0xE:
+      return (op & 0xFF) == 0x9E || (op & 0xFF) == 0xA1;
+  }
+  return 0;
+}
+
+/**
+ * Fills 'next' with the static successors of the instruction at 'addr' and
+ * returns how many there are. '*ends' is set when the instruction has to
+ * close its basic block; every successor of such an instruction is a
+ * block leader.
+ */
+static int successors(uint16_t op, uint16_t addr, uint16_t next[2],
+                      int* ends) {
+  *ends = 1;
+  if(op == 0x00EE || (op >> 12) == 0xB) {
+    return 0;
+  } else if((op >> 12) == 0x1) {
+    next[0] = op & 0x0FFF;
+    return 1;
+  } else if((op >> 12) == 0x2) {
+    next[0] = op & 0x0FFF;
+    next[1] = addr + 2;
+    return 2;
+  } else if(is_skip(op)) {
+    next[0] = addr + 2;
+    next[1] = addr + 4;
+    return 2;
+  } else if((op & 0xF0FF) == 0xF00A) {
+    next[0] = addr;
+    next[1] = addr + 2;
+    return 2;
+  }
+  *ends = 0;
+  next[0] = addr + 2;
+  return 1;
+}
+
+static int in_rom(const struct recompiler_t* rc, uint16_t addr) {
+  return addr >= CHIP8_MEMORY_START && addr + 1 < rc->rom_end;
+}
+
+static void recompiler_trace(struct recompiler_t* rc) {
+  // every address is pushed at most once, when it is first reached
+  uint16_t stack[CHIP8_MEMORY_SIZE];
+  int top = 0;
+  if(!in_rom(rc, CHIP8_MEMORY_START)) {
+    return;
+  }
+  stack[top++] = CHIP8_MEMORY_START;
+  rc->reachable[CHIP8_MEMORY_START] = 1;
+  rc->leader[CHIP8_MEMORY_START] = 1;
+  while(top > 0) {
+    uint16_t addr = stack[--top];
+    uint16_t next[2];
+    int ends;
+    int count = successors(fetch(rc, addr), addr, next, &ends);
+    for(int i = 0; i < count; i++) {
+      if(ends) {
+        rc->leader[next[i] & 0x0FFF] = 1;
+      }
+      if(in_rom(rc, next[i]) && !rc->reachable[next[i]]) {
+        rc->reachable[next[i]] = 1;
+        stack[top++] = next[i];
+      }
+    }
+  }
+}
+
+/**
+ * Decides where every block ends. Walking leaders in address order lets a
+ * block that hits RECOMPILE_MAX_BLOCK simply mark the next instruction as
+ * a leader of its own.
+ */
+static void recompiler_split(struct recompiler_t* rc) {
+  for(int start = 0; start < CHIP8_MEMORY_SIZE; start++) {
+    if(!rc->leader[start] || !rc->reachable[start]) {
+      continue;
+    }
+    uint16_t addr = start;
+    int length = 0;
+    for(;;) {
+      uint16_t next[2];
+      int ends;
+      successors(fetch(rc, addr), addr, next, &ends);
+      rc->code_map[addr >> 3] |= 1 << (addr & 7);
+      rc->code_map[(addr + 1) >> 3] |= 1 << ((addr + 1) & 7);
+      length++;
+      addr += 2;
+      if(ends || addr >= CHIP8_MEMORY_SIZE || !rc->reachable[addr] ||
+         rc->leader[addr]) {
+        break;
+      }
+      if(length == RECOMPILE_MAX_BLOCK) {
+        rc->leader[addr] = 1;
+        break;
+      }
+    }
+    rc->lengths[start] = length;
+  }
+}
+
+static void emit_bytes(FILE* fp, const uint8_t* bytes, size_t count) {
+  for(size_t i = 0; i < count; i++) {
+    fprintf(fp, "%s0x%.2X,", i % 12 == 0 ? "\n  " : " ", bytes[i]);
+  }
+  fprintf(fp, "\n");
+}
+
+static void emit_cycles(FILE* fp, int* pending) {
+  if(*pending) {
+    fprintf(fp, "  c->cycles += %d;\n", *pending);
+    *pending = 0;
+  }
+}
+
+/**
+ * Formats the op_* call for one instruction, naming the handler the way
+ * chip8_ops.h does and passing its operands as constants.
+ */
+static void handler_call(uint16_t op, char* buf, size_t size) {
+  unsigned x = (op >> 8) & 0xF, y = (op >> 4) & 0xF, n = op & 0xF;
+  unsigned nn = op & 0xFF, nnn = op & 0xFFF;
+  switch(op >> 12) {
+    case 0x0:
+      if(op == 0x00E0 || op == 0x00EE) {
+        snprintf(buf, size, "op_%.4X(c);", op);
+        return;
+      }
+      break;
+    case 0x1:
+    case 0x2:
+    case 0xA:
+    case 0xB:
+      snprintf(buf, size, "op_%XNNN(c, 0x%.3X);", op >> 12, nnn);
+      return;
+    case 0x3:
+    case 0x4:
+    case 0x6:
+    case 0x7:
+    case 0xC:
+      snprintf(buf, size, "op_%XXNN(c, %u, 0x%.2X);", op >> 12, x, nn);
+      return;
+    case 0x5:
+    case 0x9:
+      if(n == 0) {
+        snprintf(buf, size, "op_%XXY0(c, %u, %u);", op >> 12, x, y);
+        return;
+      }
+      break;
+    case 0x8:
+      if(n <= 0x7 || n == 0xE) {
+        snprintf(buf, size, "op_8XY%X(c, %u, %u);", n, x, y);
+        return;
+      }
+      break;
+    case 0xD:
+      snprintf(buf, size, "op_DXYN(c, %u, %u, %u);", x, y, n);
+      return;
+    case 0xE:
+      if(is_skip(op)) {
+        snprintf(buf, size, "op_EX%.2X(c, %u);", nn, x);
+        return;
+      }
+      break;
+    case 0xF:
+      switch(nn) {
+        case 0x07:
+        case 0x0A:
+        case 0x15:
+        case 0x18:
+        case 0x1E:
+        case 0x29:
+        case 0x33:
+        case 0x55:
+        case 0x65:
+          snprintf(buf, size, "op_FX%.2X(c, %u);", nn, x);
+          return;
+      }
+      break;
+  }
+  snprintf(buf, size, "op_raw(c, 0x%.4X);", op);
+}
+
+static void emit_write_check(FILE* fp, uint16_t op, int indent) {
+  fprintf(fp,
+          "%*sif(code_written(c->I, %d)) {\n"
+          "%*s  c->opcode = 0x%.4X;\n"
+          "%*s  return 1;\n"
+          "%*s}\n",
+          indent, "", (op & 0xFF) == 0x33 ? 3 : ((op >> 8) & 0xF) + 1, indent,
+          "", op, indent, "", indent, "");
+}
+
+/**
+ * Compiled code never fills in chip8->D; chip8->opcode is only written
+ * where the block is left, for aot.c and the state dumps.
+ */
+static void emit_block(FILE* fp, const struct recompiler_t* rc,
+                       uint16_t start) {
+  int pending = 0;
+  uint16_t op = 0;
+  fprintf(fp, "static inline int block_%.4X(struct chip8_t* c) {\n", start);
+  for(int i = 0; i < rc->lengths[start]; i++) {
+    uint16_t addr = start + 2 * i;
+    op = fetch(rc, addr);
+    char text[32];
+    chip8_disassemble(op, text, sizeof(text));
+    fprintf(fp, "  /* %.4X: %s */\n", addr, text);
+    // only the timer opcodes read the clock, so it is advanced in bulk
+    pending++;
+    if((op & 0xF0FF) == 0xF007 || (op & 0xF0FF) == 0xF015 ||
+       (op & 0xF0FF) == 0xF018) {
+      emit_cycles(fp, &pending);
+    }
+    char call[32];
+    handler_call(op, call, sizeof(call));
+    fprintf(fp, "  %s\n", call);
+
+    if((op & 0xF0FF) == 0xF033 || (op & 0xF0FF) == 0xF055) {
+      emit_cycles(fp, &pending);
+      emit_write_check(fp, op, 2);
+    }
+  }
+  emit_cycles(fp, &pending);
+  fprintf(fp, "  c->opcode = 0x%.4X;\n  return 0;\n}\n\n", op);
+}
+
+/**
+ * step() runs the single instruction at pc, so that a block cut short by
+ * the cycle budget (or entered in the middle) still runs compiled. It
+ * returns -1 when pc is not compiled code or its block was invalidated.
+ */
+static void emit_step(FILE* fp, const struct recompiler_t* rc) {
+  // kept out of line so it does not crowd the dispatch loops
+  fprintf(fp,
+          "static NOINLINE int step(struct chip8_t* c,\n"
+          "                         const uint8_t* invalid) {\n"
+          "  switch(c->pc) {\n");
+  for(int start = 0; start < CHIP8_MEMORY_SIZE; start++) {
+    for(int i = 0; i < rc->lengths[start]; i++) {
+      uint16_t addr = start + 2 * i;
+      uint16_t op = fetch(rc, addr);
+      char call[32];
+      handler_call(op, call, sizeof(call));
+      fprintf(fp,
+              "    case 0x%.4X:\n"
+              "      if(INVALID(0x%.4X)) {\n"
+              "        return -1;\n"
+              "      }\n"
+              "      c->cycles++;\n"
+              "      %s\n",
+              addr, start, call);
+      if((op & 0xF0FF) == 0xF033 || (op & 0xF0FF) == 0xF055) {
+        emit_write_check(fp, op, 6);
+      }
+      fprintf(fp,
+              "      c->opcode = 0x%.4X;\n"
+              "      return 0;\n",
+              op);
+    }
+  }
+  fprintf(fp,
+          "    default:\n"
+          "      return -1;\n"
+          "  }\n"
+          "}\n\n");
+}
+
+/**
+ * Emits the block dispatch loop. The leader switch lets the compiler inline
+ * every block and turn block-to-block transfers into a jump table lookup.
+ * run_blocks() is the loop used while no block is invalid and leaves out
+ * the per-block check; run_checked() tests every leader against 'invalid'.
+ */
+static void emit_dispatch(FILE* fp, const struct recompiler_t* rc,
+                          int checked) {
+  if(checked) {
+    fprintf(fp,
+            "static int run_checked(struct chip8_t* c, uint64_t cycles,\n"
+            "                       const uint8_t* invalid) {\n");
+  } else {
+    fprintf(fp,
+            "static int run_blocks(struct chip8_t* c, uint64_t cycles) {\n");
+  }
+  fprintf(fp,
+          "  while(c->cycles < cycles) {\n"
+          "    switch(c->pc) {\n");
+  for(int addr = 0; addr < CHIP8_MEMORY_SIZE; addr++) {
+    if(rc->lengths[addr]) {
+      fprintf(fp, "      case 0x%.4X:\n", addr);
+      if(checked) {
+        fprintf(fp,
+                "        if(c->cycles + %d <= cycles && !INVALID(0x%.4X)) {\n",
+                rc->lengths[addr], addr);
+      } else {
+        fprintf(fp, "        if(c->cycles + %d <= cycles) {\n",
+                rc->lengths[addr]);
+      }
+      if(rc->lengths[addr] == 1 && fetch(rc, addr) == (0x1000 | addr)) {
+        // an idle loop only advances the cycle count, so spin it out at
+        // once; plenty of ROMs end in one
+        fprintf(fp, "          c->cycles = cycles - 1;\n");
+      }
+      fprintf(fp,
+              "          if(block_%.4X(c)) {\n"
+              "            return 1;\n"
+              "          }\n"
+              "          continue;\n"
+              "        }\n"
+              "        break;\n",
+              addr);
+    }
+  }
+  fprintf(fp,
+          "    }\n"
+          "    // between leaders, or the block does not fit the budget\n"
+          "    int result = step(c, %s);\n"
+          "    if(result) {\n"
+          "      return result > 0;\n"
+          "    }\n"
+          "  }\n"
+          "  return 0;\n"
+          "}\n\n",
+          checked ? "invalid" : "NULL");
+}
+
+static int recompiler_emit(const struct recompiler_t* rc, const char* rom,
+                           const char* filename) {
+  FILE* fp = fopen(filename, "w");
+  if(!fp) {
+    fprintf(stderr, "can't open file: '%s'\n", filename);
+    return 0;
+  }
+  fprintf(fp,
+          "/**\n"
+          " * Generated by chip8-recompile from '%s'. Do not edit.\n"
+          " */\n"
+          "#ifndef NDEBUG\n"
+          "#define NDEBUG\n"
+          "#endif\n\n"
+          "#include \"aot.h\"\n"
+          "#include \"chip8_ops.h\"\n\n",
+          rom);
+
+  fprintf(fp, "static const uint8_t ROM[] = {");
+  emit_bytes(fp, rc->memory + CHIP8_MEMORY_START,
+             rc->rom_end - CHIP8_MEMORY_START);
+  fprintf(fp, "};\n\n");
+  fprintf(fp, "static const uint8_t CODE_MAP[CHIP8_MEMORY_SIZE / 8] = {");
+  emit_bytes(fp, rc->code_map, sizeof(rc->code_map));
+  fprintf(fp, "};\n\n");
+  fprintf(fp,
+          "static inline int code_written(uint16_t addr, int len) {\n"
+          "  for(int i = 0; i < len && addr + i < CHIP8_MEMORY_SIZE; i++) "
+          "{\n"
+          "    if(CODE_MAP[(addr + i) >> 3] & (1 << ((addr + i) & 7))) {\n"
+          "      return 1;\n"
+          "    }\n"
+          "  }\n"
+          "  return 0;\n"
+          "}\n\n");
+  // 'invalid' is NULL until the first block gets overwritten
+  fprintf(fp,
+          "#define INVALID(leader) \\\n"
+          "  (invalid && (invalid[(leader) >> 3] & (1 << ((leader) & 7))))\n"
+          "\n"
+          "#if defined(__GNUC__)\n"
+          "#define NOINLINE __attribute__((noinline))\n"
+          "#elif defined(_MSC_VER)\n"
+          "#define NOINLINE __declspec(noinline)\n"
+          "#else\n"
+          "#define NOINLINE\n"
+          "#endif\n\n");
+
+  int blocks = 0;
+  for(int addr = 0; addr < CHIP8_MEMORY_SIZE; addr++) {
+    if(rc->lengths[addr]) {
+      emit_block(fp, rc, addr);
+      blocks++;
+    }
+  }
+
+  emit_step(fp, rc);
+
+  emit_dispatch(fp, rc, 0);
+  emit_dispatch(fp, rc, 1);
+  fprintf(fp,
+          "static int run(struct chip8_t* c, uint64_t cycles,\n"
+          "               const uint8_t* invalid) {\n"
+          "  if(invalid) {\n"
+          "    return run_checked(c, cycles, invalid);\n"
+          "  }\n"
+          "  return run_blocks(c, cycles);\n"
+          "}\n\n");
+  fprintf(fp, "static const struct chip8_aot_block_t BLOCKS[] = {\n");
+  for(int addr = 0; addr < CHIP8_MEMORY_SIZE; addr++) {
+    if(rc->lengths[addr]) {
+      fprintf(fp, "  {0x%.4X, %d},\n", addr, rc->lengths[addr]);
+    }
+  }
+  fprintf(fp, "};\n\n");
+  fprintf(fp,
+          "CHIP8_AOT_EXPORT const struct chip8_aot_module_t "
+          "chip8_aot_module = {\n"
+          "  CHIP8_AOT_ABI_VERSION, CHIP8_AOT_LAYOUT, sizeof(ROM), ROM,\n"
+          "  sizeof(BLOCKS) / sizeof(BLOCKS[0]), BLOCKS, run\n"
+          "};\n");
+  fclose(fp);
+  printf("%s: %d blocks written to %s\n", rom, blocks, filename);
+  return 1;
+}
+
+int main(int argc, char const* argv[]) {
+  if(argc != 3) {
+    printf("Usage: chip8-recompile <rom file> <output .c file>\n");
+    return EXIT_FAILURE;
+  }
+
+  // load through the emulator so size limits and layout match exactly
+  static struct chip8_t chip8;
+  static struct recompiler_t rc;
+  chip8_init(&chip8);
+  if(!chip8_load_program(&chip8, argv[1])) {
+    return EXIT_FAILURE;
+  }
+  FILE* fp = fopen(argv[1], "rb");
+  fseek(fp, 0, SEEK_END);
+  rc.rom_end = CHIP8_MEMORY_START + (uint16_t)ftell(fp);
+  fclose(fp);
+  memcpy(rc.memory, chip8.memory, CHIP8_MEMORY_SIZE);
+
+  recompiler_trace(&rc);
+  recompiler_split(&rc);
+  return recompiler_emit(&rc, argv[1], argv[2]) ? EXIT_SUCCESS : EXIT_FAILURE;
+}